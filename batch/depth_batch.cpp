@@ -0,0 +1,197 @@
+#include "camerautils.h"
+#include "depthmapbuilder.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Headless depth extraction over stored stereo snapshots.
+//snap_0-*/snap_1-* files are paired by timestamp in the name, each pair is rectified with
+//stereo calibration written by camera::utils::stereoCalibrate and matched on one of jobs threads.
+//For every pair output_dir gets depth-<timestamp>.png (16 bit disparity * 16) and
+//points-<timestamp>.ply, output_dir should exist.
+//usage: depth_batch calibration.yml image_dir output_dir [jobs mode num_disparities]
+
+namespace
+{
+
+using camera::utils::Snapshot;
+
+std::vector<Snapshot> listSnapshots(const std::string& pattern)
+{
+    std::vector<cv::String> files;
+    cv::glob(pattern, files);
+    std::vector<Snapshot> snapshots;
+    for (const auto& file : files)
+    {
+        Snapshot snapshot;
+        if (camera::utils::parseSnapshot(file, snapshot))
+        {
+            snapshots.push_back(snapshot);
+        }
+    }
+    std::sort(snapshots.begin(), snapshots.end(),
+              [](const Snapshot& a, const Snapshot& b) { return a.time < b.time; });
+    return snapshots;
+}
+
+bool writePly(const std::string& fileName, const DepthPoints& points)
+{
+    std::ofstream out(fileName, std::ios::binary);
+    out << "ply\nformat binary_little_endian 1.0\n"
+        << "element vertex " << points.count << "\n"
+        << "property float x\nproperty float y\nproperty float z\n"
+        << "property uchar red\nproperty uchar green\nproperty uchar blue\n"
+        << "end_header\n";
+    for (size_t i = 0; i < points.count; ++i)
+    {
+        const float xyz[3] = {points.x[i], points.y[i], points.z[i]};
+        const unsigned char rgb[3] = {points.red[i], points.green[i], points.blue[i]};
+        out.write(reinterpret_cast<const char*>(xyz), sizeof(xyz));
+        out.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+    }
+    return static_cast<bool>(out);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 4 && argc != 7)
+    {
+        std::cerr << "usage: " << argv[0]
+                  << " calibration.yml image_dir output_dir [jobs mode num_disparities]" << std::endl;
+        return 1;
+    }
+    const std::string calibration = argv[1];
+    const std::string dir = argv[2];
+    const std::string outDir = argv[3];
+    size_t jobs = std::max(1u, std::thread::hardware_concurrency());
+    int mode = -1;
+    int numDisparities = 0;
+    if (argc == 7)
+    {
+        jobs = std::max(1, atoi(argv[4]));
+        mode = atoi(argv[5]);
+        numDisparities = atoi(argv[6]);
+    }
+
+    if (!cv::FileStorage(calibration, cv::FileStorage::READ).isOpened())
+    {
+        std::cerr << "failed to open " << calibration << std::endl;
+        return 1;
+    }
+
+    const auto pairs = camera::utils::pairSnapshots(listSnapshots(dir + "/snap_0-*"), listSnapshots(dir + "/snap_1-*"),
+                                                    camera::utils::snapshotPairTolerance);
+    if (pairs.empty())
+    {
+        std::cerr << "no stereo pairs in " << dir << std::endl;
+        return 1;
+    }
+    jobs = std::min(jobs, pairs.size());
+
+    //pairs are processed in parallel, so parallel loops inside of each pair stay on its thread
+    if (jobs > 1)
+    {
+        cv::setNumThreads(1);
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<size_t> failed(0);
+    std::mutex logGuard;
+    auto worker = [&]()
+    {
+        //matchers keep state between frames, so every thread has own builder
+        DepthMapBuilder builder;
+        builder.loadCalibrationParams(calibration);
+        if (mode >= 0)
+        {
+            builder.setMode(mode);
+        }
+        if (numDisparities > 0)
+        {
+            builder.setNumDisparities(numDisparities);
+        }
+
+        cv::Size mapSize;
+        RectifyMap leftMap, rightMap;
+        cv::Mat leftRect, rightRect, disparity, disparity16;
+        DepthPoints points;
+        for (size_t i = next++; i < pairs.size(); i = next++)
+        {
+            const cv::Mat left = cv::imread(pairs[i].first.file, cv::IMREAD_COLOR);
+            const cv::Mat right = cv::imread(pairs[i].second.file, cv::IMREAD_COLOR);
+            if (left.empty() || left.size() != right.size())
+            {
+                std::unique_lock<std::mutex> lock(logGuard);
+                std::cerr << "skipped " << pairs[i].first.file << std::endl;
+                ++failed;
+                continue;
+            }
+            try
+            {
+                if (left.size() != mapSize)
+                {
+                    mapSize = left.size();
+                    leftMap = builder.getLeftMapping(mapSize);
+                    rightMap = builder.getRightMapping(mapSize);
+                }
+                leftMap.remap(left, leftRect);
+                rightMap.remap(right, rightRect);
+
+                if (!builder.computeDepth(leftRect, rightRect, disparity, points))
+                {
+                    ++failed;
+                    continue;
+                }
+            }
+            catch(std::exception& err)
+            {
+                std::unique_lock<std::mutex> lock(logGuard);
+                std::cerr << pairs[i].first.file << ": " << err.what() << std::endl;
+                mapSize = cv::Size();
+                ++failed;
+                continue;
+            }
+            //invalid disparities are negative and saturate to zero
+            disparity.convertTo(disparity16, CV_16U);
+            const std::string stamp = pairs[i].first.stamp;
+            if (!cv::imwrite(outDir + "/depth-" + stamp + ".png", disparity16)
+                || !writePly(outDir + "/points-" + stamp + ".ply", points))
+            {
+                std::unique_lock<std::mutex> lock(logGuard);
+                std::cerr << "failed to write results of " << stamp << " to " << outDir << std::endl;
+                ++failed;
+            }
+        }
+    };
+
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < jobs; ++i)
+    {
+        threads.emplace_back(worker);
+    }
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const size_t done = pairs.size() - failed;
+    std::cout << "pairs\tfailed\tjobs\tseconds\tpairs/s" << std::endl;
+    std::cout << pairs.size() << "\t" << failed << "\t" << jobs << "\t" << seconds << "\t"
+              << (seconds > 0 ? done / seconds : 0) << std::endl;
+    return failed == 0 ? 0 : 2;
+}
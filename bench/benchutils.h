@@ -0,0 +1,95 @@
+#ifndef BENCHUTILS_H
+#define BENCHUTILS_H
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//helpers shared by benchmarks
+namespace bench
+{
+
+//mean time of one iteration, start is taken from cv::getTickCount
+inline double elapsedMs(int64_t start, int iterations)
+{
+    return (cv::getTickCount() - start) * 1000. / cv::getTickFrequency() / iterations;
+}
+
+struct DisparityDelta
+{
+    DisparityDelta() : valid(0), agreement(0), meanError(0) {}
+
+    double valid;       //% of valid pixels
+    double agreement;   //% of reference valid pixels which differ by not more than one disparity
+    double meanError;   //px, over pixels valid in both maps
+};
+
+//both maps are CV_16S scaled by DISP_SCALE, invalid pixels are at minDisparity - 1 or below
+inline DisparityDelta compareDisparity(const cv::Mat& disp, const cv::Mat& reference, int minDisparity)
+{
+    const short invalid = static_cast<short>((minDisparity - 1) * cv::StereoMatcher::DISP_SCALE);
+    size_t valid = 0;
+    size_t referenceValid = 0;
+    size_t both = 0;
+    size_t agree = 0;
+    double error = 0;
+    for (int y = 0; y < disp.rows; ++y)
+    {
+        const short* d = disp.ptr<short>(y);
+        const short* r = reference.ptr<short>(y);
+        for (int x = 0; x < disp.cols; ++x)
+        {
+            const bool v = d[x] > invalid;
+            const bool rv = r[x] > invalid;
+            valid += v;
+            referenceValid += rv;
+            if (v && rv)
+            {
+                const int diff = std::abs(d[x] - r[x]);
+                ++both;
+                error += diff;
+                agree += diff <= cv::StereoMatcher::DISP_SCALE;
+            }
+        }
+    }
+    DisparityDelta delta;
+    delta.valid = 100. * valid / disp.total();
+    delta.agreement = referenceValid > 0 ? 100. * agree / referenceValid : 0;
+    delta.meanError = both > 0 ? error / both / cv::StereoMatcher::DISP_SCALE : 0;
+    return delta;
+}
+
+//gray snap_0-*.png/snap_1-*.png snapshots of directory, paired by order of names since timestamps
+//of left and right may differ in last digits, unreadable pairs are skipped, false if no pair is left
+inline bool loadStereoPairs(const std::string& dir, std::vector<cv::Mat>& lefts, std::vector<cv::Mat>& rights)
+{
+    std::vector<cv::String> leftFiles, rightFiles;
+    cv::glob(dir + "/snap_0-*.png", leftFiles);
+    cv::glob(dir + "/snap_1-*.png", rightFiles);
+    lefts.clear();
+    rights.clear();
+    if (leftFiles.size() != rightFiles.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < leftFiles.size(); ++i)
+    {
+        cv::Mat left = cv::imread(leftFiles[i], cv::IMREAD_GRAYSCALE);
+        cv::Mat right = cv::imread(rightFiles[i], cv::IMREAD_GRAYSCALE);
+        if (left.empty() || right.empty() || left.size() != right.size())
+        {
+            std::cerr << "skip " << leftFiles[i] << std::endl;
+            continue;
+        }
+        lefts.push_back(left);
+        rights.push_back(right);
+    }
+    return !lefts.empty();
+}
+
+}
+
+#endif // BENCHUTILS_H
@@ -0,0 +1,67 @@
+#include "camerautils.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Calibrates one camera from a directory of snapshots with full resolution and downscaled
+//chessboard search, reports time and reprojection error of both modes. Corner cache of the
+//directory is removed before each mode, so detection is always measured, and after the last one.
+//usage: calib_detect_bench image_dir wcount hcount [square_size]
+//e.g. calib_detect_bench calibration_1280_720/left 9 6
+
+int main(int argc, char** argv)
+{
+    if (argc != 4 && argc != 5)
+    {
+        std::cerr << "usage: " << argv[0] << " image_dir wcount hcount [square_size]" << std::endl;
+        return 1;
+    }
+    const int wcount = atoi(argv[2]);
+    const int hcount = atoi(argv[3]);
+    const int squareSize = argc == 5 ? atoi(argv[4]) : 1;
+
+    std::vector<cv::String> names;
+    cv::glob(std::string(argv[1]) + "/*.png", names);
+    std::vector<std::string> files(names.begin(), names.end());
+    if (files.empty())
+    {
+        std::cerr << "no images in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    const camera::utils::DetectionMode modes[] = {camera::utils::DETECTION_FULL, camera::utils::DETECTION_DOWNSCALED};
+    const char* modeNames[] = {"full", "downscaled"};
+    double seconds[2] = {0, 0};
+
+    const std::string cacheFile = std::string(argv[1]) + "/" + camera::utils::cornerCacheFileName;
+    std::cout << "mode\timages\tboards\tseconds\trms" << std::endl;
+    for (int m = 0; m < 2; ++m)
+    {
+        const std::string dataFile = std::string("calib-") + modeNames[m] + ".yml";
+        std::remove(cacheFile.c_str());
+        const auto start = std::chrono::steady_clock::now();
+        const bool ok = camera::utils::calibrate(squareSize, wcount, hcount, files, dataFile, modes[m]);
+        seconds[m] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double rms = -1;
+        int boards = 0;
+        if (ok)
+        {
+            cv::FileStorage storage(dataFile, cv::FileStorage::READ);
+            storage["rms"] >> rms;
+            storage["imagesCount"] >> boards;
+        }
+        std::cout << modeNames[m] << "\t" << files.size() << "\t" << boards << "\t"
+                  << seconds[m] << "\t" << rms << std::endl;
+    }
+    std::remove(cacheFile.c_str());
+    std::cout << "saved\t" << seconds[0] - seconds[1] << " s ("
+              << (seconds[0] > 0 ? 100 * (seconds[0] - seconds[1]) / seconds[0] : 0) << "%)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,131 @@
+#include "cpu_median.h"
+
+#ifdef WITH_CUDA
+#include "cu_median.h"
+#endif
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+
+//Compares incremental temporal median with the sorting network kernel
+//(and with the CUDA kernel when built), reports timings and mismatches.
+//usage: median_bench [width height depth frames]
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+double toMs(Clock::duration d)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(d).count() / 1000.0;
+}
+
+size_t countMismatches(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < a.size(); ++i)
+    {
+        if (a[i] != b[i])
+        {
+            ++count;
+        }
+    }
+    return count;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    size_t width = 1280;
+    size_t height = 720;
+    size_t depth = 15;
+    size_t framesNumber = 100;
+    if (argc == 5)
+    {
+        width = std::strtoul(argv[1], nullptr, 10);
+        height = std::strtoul(argv[2], nullptr, 10);
+        depth = std::strtoul(argv[3], nullptr, 10);
+        framesNumber = std::strtoul(argv[4], nullptr, 10);
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [width height depth frames]" << std::endl;
+        return 1;
+    }
+
+    const size_t frameSize = width * height;
+
+    //noisy static scene, narrow value range gives many equal values in a window
+    std::mt19937 rng(42);
+    std::vector<unsigned char> scene(frameSize);
+    for (auto& v : scene)
+    {
+        v = static_cast<unsigned char>(rng() % 256);
+    }
+    std::normal_distribution<float> noise(0.f, 6.f);
+
+    cpu::Median3DFilter network(width, height, depth, cpu::Median3DFilter::SortingNetwork);
+    cpu::Median3DFilter incremental(width, height, depth, cpu::Median3DFilter::Incremental);
+#ifdef WITH_CUDA
+    cuda::Median3DFilter gpu(width, height, 8, depth);
+    Clock::duration gpuTime(0);
+    size_t gpuMismatches = 0;
+    std::vector<unsigned char> gpuOut(frameSize);
+#endif
+
+    std::vector<unsigned char> frame(frameSize);
+    std::vector<unsigned char> networkOut(frameSize);
+    std::vector<unsigned char> incrementalOut(frameSize);
+    Clock::duration networkTime(0);
+    Clock::duration incrementalTime(0);
+    size_t mismatches = 0;
+
+    for (size_t f = 0; f < framesNumber; ++f)
+    {
+        for (size_t i = 0; i < frameSize; ++i)
+        {
+            int v = scene[i] + static_cast<int>(noise(rng));
+            frame[i] = static_cast<unsigned char>(v < 0 ? 0 : (v > 255 ? 255 : v));
+        }
+
+        auto start = Clock::now();
+        network.pushFrame(frame.data());
+        network.getFilteredFrame(networkOut.data());
+        networkTime += Clock::now() - start;
+
+        start = Clock::now();
+        incremental.pushFrame(frame.data());
+        incremental.getFilteredFrame(incrementalOut.data());
+        incrementalTime += Clock::now() - start;
+
+        mismatches += countMismatches(networkOut, incrementalOut);
+
+#ifdef WITH_CUDA
+        start = Clock::now();
+        gpu.pushFrame(frame.data());
+        gpu.getFilteredFrame(gpuOut.data());
+        gpuTime += Clock::now() - start;
+        //cuda kernel starts filtering only after its window is full
+        if (f + 1 >= depth)
+        {
+            gpuMismatches += countMismatches(networkOut, gpuOut);
+        }
+#endif
+    }
+
+    std::cout << width << "x" << height << " depth " << depth << ", " << framesNumber << " frames" << std::endl;
+    std::cout << "sorting network: " << toMs(networkTime) / framesNumber << " ms/frame" << std::endl;
+    std::cout << "incremental:     " << toMs(incrementalTime) / framesNumber << " ms/frame, "
+              << mismatches << " mismatched pixels" << std::endl;
+#ifdef WITH_CUDA
+    std::cout << "cuda:            " << toMs(gpuTime) / framesNumber << " ms/frame, "
+              << gpuMismatches << " mismatched pixels" << std::endl;
+#endif
+
+    return mismatches == 0 ? 0 : 2;
+}
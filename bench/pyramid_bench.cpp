@@ -0,0 +1,150 @@
+#include "benchutils.h"
+#include "pyramidstereomatcher.h"
+#include "sgmstereomatcher.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Compares full resolution matching with coarse-to-fine pyramid matching on stereo snapshots:
+//time per pair, speedup and accuracy delta against full resolution result. A synthetic slanted
+//plane with known disparity is checked first, its coarse blocks have different estimates everywhere,
+//so refinement windows crossing block edges show up as error against ground truth.
+//usage: pyramid_bench [image_dir levels radius iterations]
+
+namespace
+{
+
+//disparity of right pixel grows along both axes, right(x, y) = left(x + d(x, y), y),
+//ground truth is expressed for left pixels
+void makeSlantedPlane(cv::Mat& left, cv::Mat& right, cv::Mat& truth, int minDisparity)
+{
+    const cv::Size size(640, 480);
+    const double a = 8;
+    const double bx = 48. / size.width;
+    const double cy = 16. / size.height;
+
+    left.create(size, CV_8U);
+    cv::RNG rng(1);
+    rng.fill(left, cv::RNG::UNIFORM, 0, 256);
+    cv::GaussianBlur(left, left, cv::Size(3, 3), 0);
+
+    cv::Mat mapX(size, CV_32F), mapY(size, CV_32F);
+    truth.create(size, CV_16S);
+    const short invalid = static_cast<short>((minDisparity - 1) * cv::StereoMatcher::DISP_SCALE);
+    for (int y = 0; y < size.height; ++y)
+    {
+        for (int x = 0; x < size.width; ++x)
+        {
+            mapX.at<float>(y, x) = static_cast<float>(x + a + bx * x + cy * y);
+            mapY.at<float>(y, x) = static_cast<float>(y);
+            //left pixel x = xr + d(xr), solved for d
+            const double d = (a + cy * y + bx * x) / (1 + bx);
+            truth.at<short>(y, x) = x - d < 0 ? invalid : static_cast<short>(cvRound(d * cv::StereoMatcher::DISP_SCALE));
+        }
+    }
+    cv::remap(left, right, mapX, mapY, cv::INTER_LINEAR, cv::BORDER_REFLECT);
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::string dir = "depthmap_img";
+    int levels = PyramidStereoMatcher::defaultLevels;
+    int radius = PyramidStereoMatcher::defaultSearchRadius;
+    int iterations = 5;
+    if (argc == 5)
+    {
+        dir = argv[1];
+        levels = atoi(argv[2]);
+        radius = atoi(argv[3]);
+        iterations = atoi(argv[4]);
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [image_dir levels radius iterations]" << std::endl;
+        return 1;
+    }
+
+    const char* names[] = { "SGBM MODE_HH", "census SGM" };
+    const int numDisparities = 96;
+    const int blockSize = 3;
+    std::vector<cv::Ptr<cv::StereoSGBM> > matchers;
+    matchers.push_back(cv::StereoSGBM::create(0, numDisparities, blockSize,
+                                              8 * blockSize * blockSize, 32 * blockSize * blockSize,
+                                              1, 63, 10, 100, 32, cv::StereoSGBM::MODE_HH));
+    matchers.push_back(SgmStereoMatcher::create(0, numDisparities));
+
+    {
+        cv::Mat left, right, truth;
+        makeSlantedPlane(left, right, truth, 0);
+        for (size_t m = 0; m < matchers.size(); ++m)
+        {
+            cv::Ptr<PyramidStereoMatcher> pyramid = PyramidStereoMatcher::create(matchers[m], levels, radius);
+            cv::Mat full, coarse;
+            matchers[m]->compute(left, right, full);
+            pyramid->compute(left, right, coarse);
+            const bench::DisparityDelta f = bench::compareDisparity(full, truth, 0);
+            const bench::DisparityDelta p = bench::compareDisparity(coarse, truth, 0);
+            const bench::DisparityDelta pf = bench::compareDisparity(coarse, full, 0);
+            std::cout << "slanted plane, " << names[m] << ": full within 1px " << f.agreement << "%, mean error "
+                      << f.meanError << " px; pyramid within 1px " << p.agreement << "%, mean error "
+                      << p.meanError << " px, within 1px of full " << pf.agreement << "%" << std::endl;
+        }
+    }
+
+    std::vector<cv::Mat> lefts, rights;
+    if (!bench::loadStereoPairs(dir, lefts, rights))
+    {
+        std::cerr << "no stereo pairs in " << dir << std::endl;
+        return 1;
+    }
+
+    std::cout << lefts.size() << " pairs, " << levels << " levels, radius " << radius << std::endl;
+    for (size_t m = 0; m < matchers.size(); ++m)
+    {
+        cv::Ptr<PyramidStereoMatcher> pyramid = PyramidStereoMatcher::create(matchers[m], levels, radius);
+        double fullMs = 0;
+        double pyramidMs = 0;
+        bench::DisparityDelta fullDelta;
+        bench::DisparityDelta delta;
+        for (size_t i = 0; i < lefts.size(); ++i)
+        {
+            const cv::Mat& left = lefts[i];
+            const cv::Mat& right = rights[i];
+            cv::Mat full, coarse;
+
+            int64_t start = cv::getTickCount();
+            for (int k = 0; k < iterations; ++k)
+            {
+                matchers[m]->compute(left, right, full);
+            }
+            fullMs += bench::elapsedMs(start, iterations);
+
+            pyramid->compute(left, right, coarse);
+            start = cv::getTickCount();
+            for (int k = 0; k < iterations; ++k)
+            {
+                pyramid->compute(left, right, coarse);
+            }
+            pyramidMs += bench::elapsedMs(start, iterations);
+
+            bench::DisparityDelta f = bench::compareDisparity(full, full, 0);
+            bench::DisparityDelta d = bench::compareDisparity(coarse, full, 0);
+            fullDelta.valid += f.valid;
+            delta.valid += d.valid;
+            delta.agreement += d.agreement;
+            delta.meanError += d.meanError;
+        }
+        const double pairs = static_cast<double>(lefts.size());
+        std::cout << names[m] << ": full " << fullMs / pairs << " ms/pair, valid " << fullDelta.valid / pairs << "%"
+                  << "; pyramid " << pyramidMs / pairs << " ms/pair, speedup " << fullMs / pyramidMs
+                  << ", valid " << delta.valid / pairs << "%, within 1px " << delta.agreement / pairs
+                  << "%, mean error " << delta.meanError / pairs << " px" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,87 @@
+#include "benchutils.h"
+#include "rectifymap.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdlib>
+#include <iostream>
+
+//Compares float map rectification (three remaps + crop, as it was done before)
+//with fixed-point cropped maps and fused color/gray remap.
+//usage: rectify_bench [width height iterations]
+
+int main(int argc, char** argv)
+{
+    cv::Size imgSize(1280, 720);
+    int iterations = 100;
+    if (argc == 4)
+    {
+        imgSize = cv::Size(atoi(argv[1]), atoi(argv[2]));
+        iterations = atoi(argv[3]);
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [width height iterations]" << std::endl;
+        return 1;
+    }
+
+    //synthetic calibration with noticeable distortion and small rotation
+    cv::Mat cameraMatrix = (cv::Mat_<double>(3, 3) << imgSize.width, 0, imgSize.width / 2.,
+                                                      0, imgSize.width, imgSize.height / 2.,
+                                                      0, 0, 1);
+    cv::Mat distCoeffs = (cv::Mat_<double>(1, 5) << -0.2, 0.05, 0, 0, 0);
+    cv::Mat R;
+    cv::Rodrigues(cv::Vec3d(0.01, -0.02, 0.005), R);
+    cv::Mat P = cameraMatrix.clone();
+    cv::Rect roi(imgSize.width / 20, imgSize.height / 20, imgSize.width * 9 / 10, imgSize.height * 9 / 10);
+
+    cv::Mat left(imgSize, CV_8UC3);
+    cv::Mat right(imgSize, CV_8UC3);
+    cv::randu(left, cv::Scalar::all(0), cv::Scalar::all(255));
+    cv::randu(right, cv::Scalar::all(0), cv::Scalar::all(255));
+
+    //float maps
+    cv::Mat mapx, mapy;
+    cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, R, P, imgSize, CV_32FC1, mapx, mapy);
+    cv::Mat leftGray, rightGray, leftGrayRect, leftColorRect, rightGrayRect;
+    cv::Mat floatGray, floatColor, floatRight;
+    int64_t start = cv::getTickCount();
+    for (int i = 0; i < iterations; ++i)
+    {
+        cv::cvtColor(left, leftGray, CV_BGR2GRAY);
+        cv::cvtColor(right, rightGray, CV_BGR2GRAY);
+        cv::remap(leftGray, leftGrayRect, mapx, mapy, cv::INTER_LINEAR);
+        floatGray = leftGrayRect(roi);
+        cv::remap(left, leftColorRect, mapx, mapy, cv::INTER_LINEAR);
+        floatColor = leftColorRect(roi);
+        cv::remap(rightGray, rightGrayRect, mapx, mapy, cv::INTER_LINEAR);
+        floatRight = rightGrayRect(roi);
+    }
+    const double floatTime = bench::elapsedMs(start, iterations);
+    const size_t floatBytes = 2 * (mapx.total() * mapx.elemSize() + mapy.total() * mapy.elemSize());
+
+    //fixed-point cropped maps
+    RectifyMap map;
+    map.init(cameraMatrix, distCoeffs, R, P, imgSize, roi);
+    cv::Mat fixedGray, fixedColor, fixedRight;
+    start = cv::getTickCount();
+    for (int i = 0; i < iterations; ++i)
+    {
+        map.remapColorGray(left, fixedColor, fixedGray);
+        cv::cvtColor(right, rightGray, CV_BGR2GRAY);
+        map.remap(rightGray, fixedRight);
+    }
+    const double fixedTime = bench::elapsedMs(start, iterations);
+    //CV_16SC2 + CV_16UC1 per pixel of roi, for left and right
+    const size_t fixedBytes = 2 * map.size().area() * (2 * sizeof(short) + sizeof(ushort));
+
+    double maxColorDiff = cv::norm(floatColor, fixedColor, cv::NORM_INF);
+    double maxGrayDiff = cv::norm(floatGray, fixedGray, cv::NORM_INF);
+
+    std::cout << imgSize.width << "x" << imgSize.height << ", " << iterations << " iterations" << std::endl;
+    std::cout << "float maps:       " << floatTime << " ms/pair, maps " << floatBytes / 1024 << " KB" << std::endl;
+    std::cout << "fixed-point maps: " << fixedTime << " ms/pair, maps " << fixedBytes / 1024 << " KB" << std::endl;
+    std::cout << "max difference: color " << maxColorDiff << ", gray " << maxGrayDiff << std::endl;
+
+    return 0;
+}
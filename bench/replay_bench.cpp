@@ -0,0 +1,66 @@
+#include "streamplayer.h"
+#include "rectifier.h"
+#include "frameprocessor.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+//Replays a camera recording through rectifier and frame processor without cameras,
+//reports decoded and processed frame rates. speed is 0 native, 1 fixed fps, 2 max.
+//usage: replay_bench recording.screc [speed fps noise_filter]
+
+int main(int argc, char** argv)
+{
+    if (argc != 2 && argc != 5)
+    {
+        std::cerr << "usage: " << argv[0] << " recording.screc [speed fps noise_filter]" << std::endl;
+        return 1;
+    }
+    StreamPlayer::Speed speed = StreamPlayer::SPEED_MAX;
+    double fps = 30;
+    bool noiseFilter = true;
+    if (argc == 5)
+    {
+        speed = static_cast<StreamPlayer::Speed>(atoi(argv[2]));
+        fps = atof(argv[3]);
+        noiseFilter = atoi(argv[4]) != 0;
+    }
+
+    Rectifier rectifier;
+    FrameProcessor processor;
+    StreamPlayer player;
+    processor.setApplyNoiseFilter(noiseFilter);
+    rectifier.setFrameCallback(std::bind(&FrameProcessor::setFrame, &processor, std::placeholders::_1, std::placeholders::_2));
+    player.setFrameCallback(std::bind(&Rectifier::setFrame, &rectifier, std::placeholders::_1, std::placeholders::_2));
+    player.setSpeed(speed, fps);
+    processor.startProcessing();
+
+    const auto start = std::chrono::steady_clock::now();
+    if (!player.startReplay(argv[1]))
+    {
+        std::cerr << "failed to open " << argv[1] << std::endl;
+        return 1;
+    }
+    while (!player.isFinished())
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    //processor keeps only the latest frame, wait for it to drain
+    processor.waitFrame(processor.getGeneration(), 200);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const unsigned long long played = player.getPlayedFrames();
+    const unsigned long long processed = processor.getGeneration();
+    const double playerCpu = player.getCpuUsage();
+    const double processorCpu = processor.getCpuUsage();
+    player.stopReplay();
+    processor.stopProcessing();
+
+    std::cout << "frames\tseconds\tdecoded fps\tprocessed\tprocessed fps\tdecode cpu%\tprocess cpu%" << std::endl;
+    std::cout << played << "\t" << seconds << "\t" << played / seconds << "\t" << processed << "\t"
+              << processed / seconds << "\t" << playerCpu << "\t" << processorCpu << std::endl;
+    return 0;
+}
@@ -0,0 +1,85 @@
+#include "benchutils.h"
+#include "sgmstereomatcher.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Compares OpenCV SGBM (MODE_HH, as used by DepthMapBuilder, and MODE_SGBM) with census SGM
+//on stereo snapshots: time per pair, share of valid pixels and agreement with MODE_HH.
+//usage: sgm_bench [image_dir iterations]
+
+int main(int argc, char** argv)
+{
+    std::string dir = "depthmap_img";
+    int iterations = 5;
+    if (argc == 3)
+    {
+        dir = argv[1];
+        iterations = atoi(argv[2]);
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [image_dir iterations]" << std::endl;
+        return 1;
+    }
+
+    std::vector<cv::Mat> lefts, rights;
+    if (!bench::loadStereoPairs(dir, lefts, rights))
+    {
+        std::cerr << "no stereo pairs in " << dir << std::endl;
+        return 1;
+    }
+
+    const int minDisparity = 0;
+    const int numDisparities = 96;
+    const int blockSize = 3;
+    std::vector<cv::Ptr<cv::StereoSGBM> > matchers;
+    matchers.push_back(cv::StereoSGBM::create(minDisparity, numDisparities, blockSize,
+                                              8 * blockSize * blockSize, 32 * blockSize * blockSize,
+                                              1, 63, 10, 100, 32, cv::StereoSGBM::MODE_HH));
+    matchers.push_back(cv::StereoSGBM::create(minDisparity, numDisparities, blockSize,
+                                              8 * blockSize * blockSize, 32 * blockSize * blockSize,
+                                              1, 63, 10, 100, 32, cv::StereoSGBM::MODE_SGBM));
+    matchers.push_back(SgmStereoMatcher::create(minDisparity, numDisparities));
+    const char* names[] = { "SGBM MODE_HH", "SGBM MODE_SGBM", "census SGM" };
+
+    std::vector<double> ms(matchers.size(), 0);
+    std::vector<bench::DisparityDelta> deltas(matchers.size());
+    for (size_t i = 0; i < lefts.size(); ++i)
+    {
+        cv::Mat reference;
+        for (size_t m = 0; m < matchers.size(); ++m)
+        {
+            cv::Mat disp;
+            matchers[m]->compute(lefts[i], rights[i], disp);
+            int64_t start = cv::getTickCount();
+            for (int k = 0; k < iterations; ++k)
+            {
+                matchers[m]->compute(lefts[i], rights[i], disp);
+            }
+            ms[m] += bench::elapsedMs(start, iterations);
+            if (m == 0)
+            {
+                reference = disp;
+            }
+            const bench::DisparityDelta delta = bench::compareDisparity(disp, reference, minDisparity);
+            deltas[m].valid += delta.valid;
+            deltas[m].agreement += delta.agreement;
+        }
+    }
+
+    const double pairs = static_cast<double>(lefts.size());
+    std::cout << lefts.size() << " pairs, " << numDisparities << " disparities, "
+              << cv::getNumThreads() << " threads" << std::endl;
+    for (size_t m = 0; m < matchers.size(); ++m)
+    {
+        std::cout << names[m] << ": " << ms[m] / pairs << " ms/pair, valid "
+                  << deltas[m].valid / pairs << "%, agreement with MODE_HH "
+                  << deltas[m].agreement / pairs << "%" << std::endl;
+    }
+    return 0;
+}
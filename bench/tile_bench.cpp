@@ -0,0 +1,95 @@
+#include "benchutils.h"
+#include "tiledstereomatcher.h"
+#include "sgmstereomatcher.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+//Scaling report of band-tiled matching from one thread to all cores on stereo snapshots.
+//mode is StereoSGBM mode or 4 for census SGM, bands 0 means two bands per thread.
+//usage: tile_bench [image_dir mode bands iterations]
+
+int main(int argc, char** argv)
+{
+    std::string dir = "depthmap_img";
+    int mode = cv::StereoSGBM::MODE_HH;
+    int bands = 0;
+    int iterations = 5;
+    if (argc == 5)
+    {
+        dir = argv[1];
+        mode = atoi(argv[2]);
+        bands = atoi(argv[3]);
+        iterations = atoi(argv[4]);
+    }
+    else if (argc != 1)
+    {
+        std::cerr << "usage: " << argv[0] << " [image_dir mode bands iterations]" << std::endl;
+        return 1;
+    }
+
+    std::vector<cv::Mat> lefts, rights;
+    if (!bench::loadStereoPairs(dir, lefts, rights))
+    {
+        std::cerr << "no stereo pairs in " << dir << std::endl;
+        return 1;
+    }
+
+    const int numDisparities = 96;
+    const int blockSize = 3;
+    cv::Ptr<cv::StereoSGBM> matcher;
+    if (mode == SgmStereoMatcher::MODE_CENSUS)
+    {
+        matcher = SgmStereoMatcher::create(0, numDisparities);
+    }
+    else
+    {
+        matcher = cv::StereoSGBM::create(0, numDisparities, blockSize,
+                                         8 * blockSize * blockSize, 32 * blockSize * blockSize,
+                                         1, 63, 10, 100, 32, mode);
+    }
+
+    //reference is untiled matching, difference shows seams introduced by bands
+    std::vector<cv::Mat> references(lefts.size());
+    for (size_t i = 0; i < lefts.size(); ++i)
+    {
+        matcher->compute(lefts[i], rights[i], references[i]);
+    }
+
+    const size_t maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    double singleMs = 0;
+    std::cout << "threads\tbands\tms/pair\tspeedup\tefficiency\tdiffers%" << std::endl;
+    for (size_t threads = 1; threads <= maxThreads; ++threads)
+    {
+        const int count = bands > 0 ? bands : static_cast<int>(2 * threads);
+        cv::Ptr<TiledStereoMatcher> tiled = TiledStereoMatcher::create(matcher, count, threads);
+
+        double ms = 0;
+        double differs = 0;
+        cv::Mat disp;
+        for (size_t i = 0; i < lefts.size(); ++i)
+        {
+            tiled->compute(lefts[i], rights[i], disp);
+            int64_t start = cv::getTickCount();
+            for (int k = 0; k < iterations; ++k)
+            {
+                tiled->compute(lefts[i], rights[i], disp);
+            }
+            ms += bench::elapsedMs(start, iterations);
+            differs += 100. * cv::countNonZero(disp != references[i]) / disp.total();
+        }
+        ms /= lefts.size();
+        differs /= lefts.size();
+        if (threads == 1)
+        {
+            singleMs = ms;
+        }
+        std::cout << threads << "\t" << count << "\t" << ms << "\t" << singleMs / ms << "\t"
+                  << singleMs / ms / threads << "\t" << differs << std::endl;
+    }
+    return 0;
+}
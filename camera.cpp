@@ -1,12 +1,17 @@
 #include "camera.h"
 
 #include "v4lcamera.h"
+#include "stagestats.h"
+#include "pipelinetrace.h"
 
 #include <iostream>
 
 Camera::Camera()
     : stop(false)
     , freeForSnap(true)
+    , cameraId(-1)
+    , buffersCount(camera::utils::V4LCamera::defaultBuffersCount)
+    , droppedFrames(0)
 {
 }
 
@@ -15,7 +20,7 @@ Camera::~Camera()
     stopCapture();
 }
 
-void Camera::setFrameCallback(std::function<void (cv::Mat&)> func)
+void Camera::setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func)
 {
     std::unique_lock<std::mutex> lock(guard);
     frameCallback = func;
@@ -25,27 +30,65 @@ void Camera::capturing(int cameraId, camera::utils::VideoDevFormat format)
 {
     try
     {
-        camera::utils::V4LCamera camera(cameraId, format);
+        camera::utils::V4LCamera camera(cameraId, format, buffersCount);
 
         camera.startCapture();
 
         captureStarted.set_value(true);
-        std::vector<char> frameBuffer;
-        cv::Mat frame;
+        framePool.reserve(format.height, format.width, CV_8UC3);
+
+        std::shared_ptr<cv::Mat> frame;
+        FrameInfo info;
+        cpuUsage.startThread();
+        PipelineTrace::setThreadName("camera " + std::to_string(cameraId));
         bool done = false;
         while(!done)
         {
             try
             {
-                camera.getFrame(frameBuffer);
-                frame = cv::imdecode(frameBuffer, CV_LOAD_IMAGE_UNCHANGED);
+                cpuUsage.update();
+                ScopedTraceEvent frameEvent("camera frame");
+                {
+                    //decode directly from driver memory, buffer is re-queued when lease is released
+                    camera::utils::V4LCamera::FrameLease lease;
+                    {
+                        ScopedStageTimer timer(StageStatistics::STAGE_CAPTURE);
+                        lease = camera.acquireFrame();
+                    }
+                    droppedFrames = camera.getDroppedFrames();
+                    info = FrameInfo(lease.timestamp(), lease.sequence());
+                    frameEvent.setFrame(info);
+                    const cv::Mat rawData(1, static_cast<int>(lease.size()), CV_8UC1, const_cast<char*>(lease.data()));
+                    {
+                        std::unique_lock<std::mutex> lock(recordGuard);
+                        if (recorder.isOpen())
+                        {
+                            recorder.write(lease.data(), lease.size(), info);
+                        }
+                    }
+                    //truncated payload is skipped before decoding, otherwise imdecode could leave
+                    //previous content of pooled buffer in place, consumers share frame without copying
+                    frame.reset();
+                    if (isCompleteJpeg(lease.data(), lease.size()))
+                    {
+                        frame = framePool.acquire(format.height, format.width, CV_8UC3);
+                        ScopedStageTimer timer(StageStatistics::STAGE_DECODE);
+                        cv::imdecode(rawData, CV_LOAD_IMAGE_UNCHANGED, frame.get());
+                    }
+                }
+
+                if (!frame || frame->empty())
+                {
+                    done = stop;
+                    continue;
+                }
 
                 //take snapshoot
                 {
                     std::unique_lock<std::mutex> lock(snapGuard);
                     if (!freeForSnap && !snapFileName.empty())
                     {
-                        cv::imwrite(snapFileName, frame);
+                        cv::imwrite(snapFileName, *frame);
                         snapFileName.clear();
                         freeForSnap = true;
                     }
@@ -53,7 +96,7 @@ void Camera::capturing(int cameraId, camera::utils::VideoDevFormat format)
 
                 if (frameCallback)
                 {
-                    frameCallback(frame);
+                    frameCallback(frame, info);
                 }
                 done = stop;
             }
@@ -80,13 +123,40 @@ int Camera::getId() const
     return cameraId;
 }
 
+void Camera::setBuffersCount(unsigned count)
+{
+    buffersCount = count;
+}
+
+unsigned Camera::getBuffersCount() const
+{
+    return buffersCount;
+}
+
+unsigned long long Camera::getDroppedFrames() const
+{
+    return droppedFrames;
+}
+
+double Camera::getCpuUsage()
+{
+    return cpuUsage.getUsage();
+}
+
+FramePool::Statistics Camera::getPoolStatistics() const
+{
+    return framePool.getStatistics();
+}
+
 bool Camera::startCapture(int cameraId, const camera::utils::VideoDevFormat& format)
 {
     this->cameraId = cameraId;
+    captureFormat = format;
 
     stopCapture();
 
     stop = false;
+    droppedFrames = 0;
     captureStarted = std::move(std::promise<bool>());
 
     auto wait = captureStarted.get_future();
@@ -134,3 +204,32 @@ bool Camera::canTakeSnapshoot() const
    std::unique_lock<std::mutex> lock(snapGuard);
    return freeForSnap;
 }
+
+bool Camera::startRecording(const std::string &fileName)
+{
+    std::unique_lock<std::mutex> lock(recordGuard);
+    //frame size is known only after capture was started
+    if (captureFormat.width == 0 || captureFormat.height == 0)
+    {
+        return false;
+    }
+    return recorder.open(fileName, captureFormat.width, captureFormat.height);
+}
+
+void Camera::stopRecording()
+{
+    std::unique_lock<std::mutex> lock(recordGuard);
+    recorder.close();
+}
+
+bool Camera::isRecording() const
+{
+    std::unique_lock<std::mutex> lock(recordGuard);
+    return recorder.isOpen();
+}
+
+unsigned long long Camera::getRecordedFrames() const
+{
+    std::unique_lock<std::mutex> lock(recordGuard);
+    return recorder.getFramesCount();
+}
@@ -2,6 +2,9 @@
 #define CAMERA_H
 
 #include "camerautils.h"
+#include "framesource.h"
+#include "cpuusage.h"
+#include "recordedstream.h"
 
 #include <opencv2/opencv.hpp>
 
@@ -10,6 +13,7 @@
 #include <mutex>
 #include <thread>
 #include <future>
+#include <atomic>
 
 class Camera
 {
@@ -22,7 +26,7 @@ public:
 
     Camera& operator=(const Camera&) = delete;
 
-    void setFrameCallback(std::function<void (cv::Mat&)> func);
+    void setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func);
 
     bool startCapture(int cameraId, const camera::utils::VideoDevFormat& format);
 
@@ -32,15 +36,35 @@ public:
 
     bool canTakeSnapshoot() const;
 
+    //raw payloads and timestamps of captured frames are appended to the file, for StreamPlayer
+    bool startRecording(const std::string& fileName);
+
+    void stopRecording();
+
+    bool isRecording() const;
+
+    unsigned long long getRecordedFrames() const;
+
     int getId() const;
 
+    //number of V4L2 buffers in capture ring, applied on next capture start
+    void setBuffersCount(unsigned count);
+
+    unsigned getBuffersCount() const;
+
+    unsigned long long getDroppedFrames() const;
+
+    double getCpuUsage();
+
+    FramePool::Statistics getPoolStatistics() const;
+
 private:
 
     void capturing(int cameraId, camera::utils::VideoDevFormat format);
 
 private:
 
-    std::function<void (cv::Mat&)> frameCallback;
+    std::function<void (const FramePtr&, const FrameInfo&)> frameCallback;
     mutable std::mutex guard;
     std::thread thread;
     bool stop;
@@ -50,8 +74,16 @@ private:
     bool freeForSnap;
     std::string snapFileName;
 
+    mutable std::mutex recordGuard;
+    StreamWriter recorder;
+
     std::string lastError;
     int cameraId;
+    camera::utils::VideoDevFormat captureFormat;
+    std::atomic<unsigned> buffersCount;
+    std::atomic<unsigned long long> droppedFrames;
+    CpuUsageCounter cpuUsage;
+    FramePool framePool;
 };
 
 #endif // CAMERA_H
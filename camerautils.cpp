@@ -1,6 +1,16 @@
 #include "camerautils.h"
+#include "threadpool.h"
 
 #include <stdexcept>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
 
 #include <opencv2/opencv.hpp>
 
@@ -155,43 +165,361 @@ std::vector<VideoDevFormat> getDeviceFormats(int id)
 
 namespace
 {
-    void getImagePoints(const cv::Size& boardSize,
-                        const std::vector<std::string> &files,
+    struct BoardDetection
+    {
+        BoardDetection() : found(false) {}
+
+        bool found;
+        cv::Size imageSize;
+        std::vector<cv::Point2f> corners;
+    };
+
+    //width of image for downscaled chessboard search
+    const int detectionWidth = 640;
+
+    void detectBoard(const cv::Size& boardSize, const cv::Mat& img, DetectionMode mode, BoardDetection& detection)
+    {
+        detection.imageSize = img.size();
+        detection.found = !img.empty() && findChessboard(img, boardSize, mode, detection.corners);
+    }
+
+    std::string getDirectory(const std::string& file)
+    {
+        const auto pos = file.find_last_of('/');
+        return pos == std::string::npos ? std::string(".") : file.substr(0, pos);
+    }
+
+    bool readFile(const std::string& file, std::vector<uchar>& data)
+    {
+        std::ifstream in(file, std::ios::binary);
+        data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        return !in.bad() && !data.empty();
+    }
+
+    //FNV-1a
+    unsigned long long hashData(const std::vector<uchar>& data)
+    {
+        unsigned long long hash = 14695981039346656037ULL;
+        for (auto byte : data)
+        {
+            hash ^= byte;
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    //detections of images keyed by content hash, board size and detection mode,
+    //kept in one file per directory of images
+    class CornerCache
+    {
+    public:
+        static const int version = 1;
+
+        void load(const std::vector<const std::vector<std::string>*>& lists)
+        {
+            for (auto list : lists)
+            {
+                for (auto& file : *list)
+                {
+                    const std::string dir = getDirectory(file);
+                    if (dirs.find(dir) == dirs.end())
+                    {
+                        loadDirectory(dir, dirs[dir]);
+                    }
+                }
+            }
+        }
+
+        static std::string makeKey(unsigned long long hash, const cv::Size& boardSize, DetectionMode mode)
+        {
+            char key[64];
+            snprintf(key, sizeof(key), "c%016llx_%dx%d_%d", hash, boardSize.width, boardSize.height, static_cast<int>(mode));
+            return key;
+        }
+
+        bool find(const std::string& file, const std::string& key, BoardDetection& detection)
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            const Directory& dir = dirs[getDirectory(file)];
+            auto it = dir.entries.find(key);
+            if (it == dir.entries.end())
+            {
+                return false;
+            }
+            detection = it->second;
+            return true;
+        }
+
+        void add(const std::string& file, const std::string& key, const BoardDetection& detection)
+        {
+            std::unique_lock<std::mutex> lock(guard);
+            Directory& dir = dirs[getDirectory(file)];
+            dir.entries[key] = detection;
+            dir.changed = true;
+        }
+
+        //unwritable directories are skipped, detection is simply repeated next time
+        void save()
+        {
+            for (auto& dir : dirs)
+            {
+                if (dir.second.changed)
+                {
+                    saveDirectory(dir.first, dir.second);
+                }
+            }
+        }
+
+    private:
+        struct Directory
+        {
+            Directory() : changed(false) {}
+
+            std::map<std::string, BoardDetection> entries;
+            bool changed;
+        };
+
+        static void loadDirectory(const std::string& dir, Directory& entries)
+        {
+            try
+            {
+                cv::FileStorage storage(dir + "/" + cornerCacheFileName, cv::FileStorage::READ);
+                if (!storage.isOpened() || static_cast<int>(storage["version"]) != version)
+                {
+                    return;
+                }
+                cv::FileNode nodes = storage["entries"];
+                for (auto it = nodes.begin(); it != nodes.end(); ++it)
+                {
+                    BoardDetection detection;
+                    detection.found = static_cast<int>((*it)["found"]) != 0;
+                    detection.imageSize = cv::Size(static_cast<int>((*it)["width"]), static_cast<int>((*it)["height"]));
+                    cv::Mat corners;
+                    (*it)["corners"] >> corners;
+                    if (!corners.empty())
+                    {
+                        detection.corners.assign(corners.begin<cv::Point2f>(), corners.end<cv::Point2f>());
+                    }
+                    entries.entries[static_cast<std::string>((*it)["key"])] = detection;
+                }
+            }
+            catch(std::exception& err)
+            {
+                //broken cache is rebuilt
+                entries.entries.clear();
+            }
+        }
+
+        static void saveDirectory(const std::string& dir, const Directory& entries)
+        {
+            try
+            {
+                cv::FileStorage storage(dir + "/" + cornerCacheFileName, cv::FileStorage::WRITE);
+                if (!storage.isOpened())
+                {
+                    return;
+                }
+                storage << "version" << version;
+                storage << "entries" << "[";
+                for (auto& entry : entries.entries)
+                {
+                    const BoardDetection& detection = entry.second;
+                    storage << "{" << "key" << entry.first
+                            << "found" << static_cast<int>(detection.found)
+                            << "width" << detection.imageSize.width
+                            << "height" << detection.imageSize.height;
+                    if (!detection.corners.empty())
+                    {
+                        storage << "corners" << cv::Mat(detection.corners);
+                    }
+                    storage << "}";
+                }
+                storage << "]";
+            }
+            catch(std::exception& err)
+            {
+                //cache is optional
+            }
+        }
+
+        std::mutex guard;
+        std::map<std::string, Directory> dirs;
+    };
+
+    //one task per image of all lists, each list gets detections in its own order,
+    //images with cached detection are not decoded
+    void detectBoards(const cv::Size& boardSize,
+                      const std::vector<const std::vector<std::string>*>& lists,
+                      DetectionMode mode,
+                      std::vector<std::vector<BoardDetection>>& detections,
+                      const ProgressCallback& progress)
+    {
+        size_t total = 0;
+        detections.resize(lists.size());
+        for (size_t l = 0; l < lists.size(); ++l)
+        {
+            detections[l].assign(lists[l]->size(), BoardDetection());
+            total += lists[l]->size();
+        }
+
+        CornerCache cache;
+        cache.load(lists);
+
+        std::atomic<size_t> done(0);
+        std::vector<ThreadPool::Task> tasks;
+        tasks.reserve(total);
+        for (size_t l = 0; l < lists.size(); ++l)
+        {
+            for (size_t i = 0; i < lists[l]->size(); ++i)
+            {
+                tasks.push_back([&, l, i](size_t)
+                {
+                    const std::string& file = (*lists[l])[i];
+                    std::vector<uchar> data;
+                    if (readFile(file, data))
+                    {
+                        const std::string key = CornerCache::makeKey(hashData(data), boardSize, mode);
+                        if (!cache.find(file, key, detections[l][i]))
+                        {
+                            detectBoard(boardSize, cv::imdecode(data, CV_LOAD_IMAGE_GRAYSCALE), mode, detections[l][i]);
+                            cache.add(file, key, detections[l][i]);
+                        }
+                    }
+                    const size_t count = ++done;
+                    if (progress)
+                    {
+                        progress(count, total);
+                    }
+                });
+            }
+        }
+
+        ThreadPool pool;
+        pool.run(tasks);
+
+        cache.save();
+    }
+
+    //size of first image and corners of images where chessboard was found
+    void getImagePoints(const std::vector<BoardDetection>& detections,
                         std::vector<std::vector<cv::Point2f>>& imagePoints,
                         cv::Size& imageSize)
     {
-        imageSize = cv::Size(-1,-1);
+        imageSize = detections.empty() ? cv::Size(-1,-1) : detections.front().imageSize;
         imagePoints.clear();
-        std::vector<cv::Point2f> pointbuf;
-        for (auto& ifn : files)
+        for (auto& detection : detections)
         {
-            cv::Mat img = cv::imread(ifn, CV_LOAD_IMAGE_GRAYSCALE);
-
-            if (imageSize.width == -1)
+            if (detection.found)
             {
-                imageSize = img.size();
+                imagePoints.push_back(detection.corners);
             }
+        }
+    }
 
-            pointbuf.clear();
-            bool found = cv::findChessboardCorners(img, boardSize, pointbuf, CV_CALIB_CB_ADAPTIVE_THRESH |
-                                                                             CV_CALIB_CB_FILTER_QUADS);
-            if(found)
+    //indices of pairs with chessboard found on both sides, lists stay in step,
+    //pairs are skipped when size of either image differs from first used pair
+    void getPairImagePoints(const std::vector<BoardDetection>& left,
+                            const std::vector<BoardDetection>& right,
+                            std::vector<std::vector<cv::Point2f>>& imagePointsLeft,
+                            std::vector<std::vector<cv::Point2f>>& imagePointsRight,
+                            std::vector<size_t>& pairs,
+                            cv::Size& imageSize)
+    {
+        imagePointsLeft.clear();
+        imagePointsRight.clear();
+        pairs.clear();
+        imageSize = cv::Size(-1,-1);
+        for (size_t i = 0; i < left.size() && i < right.size(); ++i)
+        {
+            if (left[i].found && right[i].found && left[i].imageSize == right[i].imageSize &&
+                (pairs.empty() || left[i].imageSize == imageSize))
             {
-                cv::cornerSubPix(img, pointbuf, cv::Size(11,11),
-                            cv::Size(-1,-1), cv::TermCriteria( CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 30, 0.1 ));
-
-                imagePoints.push_back(pointbuf);
+                imageSize = left[i].imageSize;
+                imagePointsLeft.push_back(left[i].corners);
+                imagePointsRight.push_back(right[i].corners);
+                pairs.push_back(i);
             }
         }
     }
+
+    double getSquaredError(const std::vector<cv::Point2f>& points, const std::vector<cv::Point2f>& projected)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < points.size(); ++i)
+        {
+            const cv::Point2f d = points[i] - projected[i];
+            sum += d.x * d.x + d.y * d.y;
+        }
+        return sum;
+    }
+
+    //rms reprojection error of one pair, pose of left camera is estimated by calibrated left camera,
+    //pose of right camera follows from stereo extrinsics
+    double getPairError(const std::vector<cv::Point3f>& objectPoints,
+                        const std::vector<cv::Point2f>& imagePointsLeft,
+                        const std::vector<cv::Point2f>& imagePointsRight,
+                        const cv::Mat& cameraMatrixLeft, const cv::Mat& distCoeffsLeft,
+                        const cv::Mat& cameraMatrixRight, const cv::Mat& distCoeffsRight,
+                        const cv::Mat& R, const cv::Mat& T)
+    {
+        cv::Mat rvecLeft, tvecLeft;
+        cv::solvePnP(objectPoints, imagePointsLeft, cameraMatrixLeft, distCoeffsLeft, rvecLeft, tvecLeft);
+
+        cv::Mat rotationLeft;
+        cv::Rodrigues(rvecLeft, rotationLeft);
+        cv::Mat rvecRight;
+        cv::Rodrigues(R * rotationLeft, rvecRight);
+        const cv::Mat tvecRight = R * tvecLeft + T;
+
+        std::vector<cv::Point2f> projectedLeft, projectedRight;
+        cv::projectPoints(objectPoints, rvecLeft, tvecLeft, cameraMatrixLeft, distCoeffsLeft, projectedLeft);
+        cv::projectPoints(objectPoints, rvecRight, tvecRight, cameraMatrixRight, distCoeffsRight, projectedRight);
+
+        const double sum = getSquaredError(imagePointsLeft, projectedLeft) +
+                           getSquaredError(imagePointsRight, projectedRight);
+        return std::sqrt(sum / (imagePointsLeft.size() + imagePointsRight.size()));
+    }
 }
 
+bool findChessboard(const cv::Mat &gray, const cv::Size &boardSize, DetectionMode mode, std::vector<cv::Point2f> &corners)
+{
+    bool found = false;
+    const double scale = static_cast<double>(detectionWidth) / gray.cols;
+    if (mode == DETECTION_DOWNSCALED && scale < 1)
+    {
+        //fast check rejects images without chessboard before slow quad search
+        cv::Mat small;
+        cv::resize(gray, small, cv::Size(), scale, scale, cv::INTER_AREA);
+        found = cv::findChessboardCorners(small, boardSize, corners, CV_CALIB_CB_ADAPTIVE_THRESH |
+                                                                     CV_CALIB_CB_FILTER_QUADS |
+                                                                     CV_CALIB_CB_FAST_CHECK);
+        for (auto& corner : corners)
+        {
+            //pixel centers are kept in place
+            corner.x = static_cast<float>((corner.x + 0.5) / scale - 0.5);
+            corner.y = static_cast<float>((corner.y + 0.5) / scale - 0.5);
+        }
+    }
+    else
+    {
+        found = cv::findChessboardCorners(gray, boardSize, corners, CV_CALIB_CB_ADAPTIVE_THRESH |
+                                                                    CV_CALIB_CB_FILTER_QUADS);
+    }
+    if (found)
+    {
+        cv::cornerSubPix(gray, corners, cv::Size(11,11),
+                    cv::Size(-1,-1), cv::TermCriteria( CV_TERMCRIT_EPS+CV_TERMCRIT_ITER, 30, 0.1 ));
+    }
+    return found;
+}
 
 bool calibrate(int squareSize,
                int wcount,
                int hcount,
                const std::vector<std::string> &files,
-               const std::string &fileName)
+               const std::string &fileName,
+               DetectionMode mode,
+               const ProgressCallback& progress)
 {
     //generate Chessbard pattern
     cv::Size boardSize(wcount, hcount);
@@ -205,9 +533,12 @@ bool calibrate(int squareSize,
     }
 
     //extract image points
+    std::vector<std::vector<BoardDetection>> detections;
+    detectBoards(boardSize, {&files}, mode, detections, progress);
+
     cv::Size imageSize;
     std::vector<std::vector<cv::Point2f>> imagePoints;
-    getImagePoints(boardSize, files, imagePoints, imageSize);
+    getImagePoints(detections[0], imagePoints, imageSize);
 
     //set correspondance between image points and object
     objectPoints.resize(imagePoints.size(),objectPoints[0]);
@@ -218,8 +549,8 @@ bool calibrate(int squareSize,
 
     std::vector<cv::Mat> rvecs, tvecs;
 
-    cv::calibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix,
-                        distCoeffs, rvecs, tvecs, CV_CALIB_FIX_K4|CV_CALIB_FIX_K5);
+    const double rms = cv::calibrateCamera(objectPoints, imagePoints, imageSize, cameraMatrix,
+                                           distCoeffs, rvecs, tvecs, CV_CALIB_FIX_K4|CV_CALIB_FIX_K5);
 
     bool ok = cv::checkRange(cameraMatrix) && cv::checkRange(distCoeffs);
 
@@ -228,17 +559,77 @@ bool calibrate(int squareSize,
         cv::FileStorage storage(fileName, cv::FileStorage::WRITE);
         storage << "cameraMatrix" << cameraMatrix;
         storage << "distCoeffs" << distCoeffs;
+        storage << "rms" << rms;
+        storage << "imagesCount" << static_cast<int>(imagePoints.size());
     }
 
     return ok;
 }
 
+bool parseSnapshot(const std::string &file, Snapshot &snapshot)
+{
+    const size_t slash = file.find_last_of("/\\");
+    const std::string name = file.substr(slash == std::string::npos ? 0 : slash + 1);
+    const size_t dash = name.find('-');
+    const size_t dot = name.rfind('.');
+    if (dash == std::string::npos || dot == std::string::npos || dot < dash + 19)
+    {
+        return false;
+    }
+    const std::string stamp = name.substr(dash + 1, dot - dash - 1);
+    if (stamp.size() != 18 || stamp[8] != '-')
+    {
+        return false;
+    }
+    const long long date = atoll(stamp.substr(0, 8).c_str());
+    const int hours = atoi(stamp.substr(9, 2).c_str());
+    const int minutes = atoi(stamp.substr(11, 2).c_str());
+    const int seconds = atoi(stamp.substr(13, 2).c_str());
+    const int ms = atoi(stamp.substr(15, 3).c_str());
+    snapshot.file = file;
+    snapshot.stamp = stamp;
+    //days are not converted to a calendar, pairs never cross midnight by more than tolerance
+    snapshot.time = date * 86400000LL + ((hours * 60 + minutes) * 60 + seconds) * 1000LL + ms;
+    return true;
+}
+
+std::vector<std::pair<Snapshot, Snapshot>> pairSnapshots(const std::vector<Snapshot> &lefts,
+                                                         const std::vector<Snapshot> &rights,
+                                                         long long tolerance)
+{
+    std::vector<std::pair<Snapshot, Snapshot>> pairs;
+    size_t r = 0;
+    for (const auto& left : lefts)
+    {
+        while (r < rights.size() && rights[r].time < left.time - tolerance)
+        {
+            ++r;
+        }
+        size_t best = r;
+        for (size_t i = r; i < rights.size() && rights[i].time <= left.time + tolerance; ++i)
+        {
+            if (std::llabs(rights[i].time - left.time) < std::llabs(rights[best].time - left.time))
+            {
+                best = i;
+            }
+        }
+        if (best < rights.size() && std::llabs(rights[best].time - left.time) <= tolerance)
+        {
+            pairs.push_back(std::make_pair(left, rights[best]));
+            r = best + 1;
+        }
+    }
+    return pairs;
+}
+
 bool stereoCalibrate(int squareSize,
                      int wcount,
                      int hcount,
                      const std::vector<std::string> &filesLeft,
                      const std::vector<std::string> &filesRight,
-                     const std::string &fileName)
+                     const std::string &fileName,
+                     DetectionMode mode,
+                     const ProgressCallback& progress)
 {
     //generate Chessbard pattern
     cv::Size boardSize(wcount, hcount);
@@ -251,14 +642,76 @@ bool stereoCalibrate(int squareSize,
         }
     }
 
+    //dialogs give files in any order, so pairs are found by timestamps of snapshot
+    std::vector<std::string> unpaired;
+    std::vector<Snapshot> snapshots[2];
+    const std::vector<std::string>* files[2] = {&filesLeft, &filesRight};
+    for (int side = 0; side < 2; ++side)
+    {
+        for (const auto& file : *files[side])
+        {
+            Snapshot snapshot;
+            if (parseSnapshot(file, snapshot))
+            {
+                snapshots[side].push_back(snapshot);
+            }
+            else
+            {
+                unpaired.push_back(file);
+            }
+        }
+        std::sort(snapshots[side].begin(), snapshots[side].end(),
+                  [](const Snapshot& a, const Snapshot& b) { return a.time < b.time; });
+    }
+
+    std::vector<std::string> pairedLeft;
+    std::vector<std::string> pairedRight;
+    std::set<std::string> used;
+    for (const auto& pair : pairSnapshots(snapshots[0], snapshots[1], snapshotPairTolerance))
+    {
+        pairedLeft.push_back(pair.first.file);
+        pairedRight.push_back(pair.second.file);
+        used.insert(pair.first.file);
+        used.insert(pair.second.file);
+    }
+    for (int side = 0; side < 2; ++side)
+    {
+        for (const auto& snapshot : snapshots[side])
+        {
+            if (used.count(snapshot.file) == 0)
+            {
+                unpaired.push_back(snapshot.file);
+            }
+        }
+    }
+
+    //images with arbitrary names can only be paired by index as before
+    if (snapshots[0].empty() && snapshots[1].empty() && filesLeft.size() == filesRight.size())
+    {
+        pairedLeft = filesLeft;
+        pairedRight = filesRight;
+        unpaired.clear();
+    }
+
+    if (pairedLeft.empty())
+    {
+        return false;
+    }
+
     //extract image points
-    cv::Size imageSize;
+    std::vector<std::vector<BoardDetection>> detections;
+    detectBoards(boardSize, {&pairedLeft, &pairedRight}, mode, detections, progress);
 
     std::vector<std::vector<cv::Point2f>> imagePointsLeft;
-    getImagePoints(boardSize, filesLeft, imagePointsLeft, imageSize);
-
     std::vector<std::vector<cv::Point2f>> imagePointsRight;
-    getImagePoints(boardSize, filesRight, imagePointsRight, imageSize);
+    std::vector<size_t> pairs;
+    cv::Size imageSize;
+    getPairImagePoints(detections[0], detections[1], imagePointsLeft, imagePointsRight, pairs, imageSize);
+
+    if (pairs.empty())
+    {
+        return false;
+    }
 
     //set correspondance between image points and object
     objectPoints.resize(imagePointsLeft.size(),objectPoints[0]);
@@ -273,15 +726,15 @@ bool stereoCalibrate(int squareSize,
     cv::Mat distCoeffsLeft, distCoeffsRight;
     cv::Mat R, T, E, F;
 
-    cv::stereoCalibrate(objectPoints, imagePointsLeft, imagePointsRight,
-                        cameraMatrixLeft, distCoeffsLeft, cameraMatrixRight, distCoeffsRight, imageSize, R, T, E, F,
-                        cv::CALIB_FIX_ASPECT_RATIO +
-                        cv::CALIB_ZERO_TANGENT_DIST +
-                        cv::CALIB_USE_INTRINSIC_GUESS +
-                        cv::CALIB_SAME_FOCAL_LENGTH +
-                        cv::CALIB_RATIONAL_MODEL +
-                        cv::CALIB_FIX_K3 + cv::CALIB_FIX_K4 + cv::CALIB_FIX_K5,
-                        cvTermCriteria(CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, 100, 1e-5));
+    const double rms = cv::stereoCalibrate(objectPoints, imagePointsLeft, imagePointsRight,
+                                           cameraMatrixLeft, distCoeffsLeft, cameraMatrixRight, distCoeffsRight, imageSize, R, T, E, F,
+                                           cv::CALIB_FIX_ASPECT_RATIO +
+                                           cv::CALIB_ZERO_TANGENT_DIST +
+                                           cv::CALIB_USE_INTRINSIC_GUESS +
+                                           cv::CALIB_SAME_FOCAL_LENGTH +
+                                           cv::CALIB_RATIONAL_MODEL +
+                                           cv::CALIB_FIX_K3 + cv::CALIB_FIX_K4 + cv::CALIB_FIX_K5,
+                                           cvTermCriteria(CV_TERMCRIT_ITER+CV_TERMCRIT_EPS, 100, 1e-5));
 
     bool ok = cv::checkRange(cameraMatrixLeft) && cv::checkRange(distCoeffsLeft) &&
               cv::checkRange(cameraMatrixRight) && cv::checkRange(distCoeffsRight);
@@ -297,6 +750,29 @@ bool stereoCalibrate(int squareSize,
         storage << "T" << T;
         storage << "E" << E;
         storage << "F" << F;
+        storage << "rms" << rms;
+        storage << "imagesCount" << static_cast<int>(imagePointsLeft.size());
+
+        //errors of used pairs, pairs with large error are candidates for removal
+        storage << "pairs" << "[";
+        for (size_t i = 0; i < pairs.size(); ++i)
+        {
+            const double error = getPairError(objectPoints[i], imagePointsLeft[i], imagePointsRight[i],
+                                              cameraMatrixLeft, distCoeffsLeft,
+                                              cameraMatrixRight, distCoeffsRight, R, T);
+            storage << "{" << "left" << pairedLeft[pairs[i]]
+                    << "right" << pairedRight[pairs[i]]
+                    << "rms" << error << "}";
+        }
+        storage << "]";
+
+        //files without partner are not used
+        storage << "unpaired" << "[";
+        for (const auto& file : unpaired)
+        {
+            storage << file;
+        }
+        storage << "]";
     }
 
     return ok;
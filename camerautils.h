@@ -3,6 +3,9 @@
 
 #include <vector>
 #include <string>
+#include <functional>
+
+#include <opencv2/opencv.hpp>
 
 namespace camera { 
 namespace utils {
@@ -44,18 +47,67 @@ private:
     int fileDesc;
 };
 
+//number of images with finished chessboard detection and their total count,
+//called from detection threads
+typedef std::function<void (size_t done, size_t total)> ProgressCallback;
+
+enum DetectionMode
+{
+    DETECTION_FULL,         //chessboard search on full resolution image
+    DETECTION_DOWNSCALED    //search with fast check on downscaled image, corners refined on full resolution
+};
+
+//corners of chessboard in gray image refined to subpixel accuracy, false if chessboard is not found
+bool findChessboard(const cv::Mat& gray, const cv::Size& boardSize, DetectionMode mode, std::vector<cv::Point2f>& corners);
+
+//detected corners are cached in this file in directory of images,
+//images are detected again only when their content, board size or detection mode changes
+const char* const cornerCacheFileName = "corners-cache.yml";
+
+//chessboards are detected concurrently, one task per image,
+//reprojection error and number of used images are stored with calibration data
 bool calibrate(int squareSize,
                int wcount,
                int hcount,
                const std::vector<std::string>& files,
-               const std::string& fileName);
+               const std::string& fileName,
+               DetectionMode mode = DETECTION_DOWNSCALED,
+               const ProgressCallback& progress = ProgressCallback());
+
+//snapshot file named prefix-yyyyMMdd-hhmmsszzz.ext as made by utils::getTimestampFileName
+struct Snapshot
+{
+    Snapshot() : time(0) {}
+
+    std::string file;
+    std::string stamp;
+    long long time; //ms, only for pairing
+};
+
+//false if name has no timestamp
+bool parseSnapshot(const std::string& file, Snapshot& snapshot);
+
+//both lists should be sorted by time, every left takes the nearest unused right within tolerance
+std::vector<std::pair<Snapshot, Snapshot>> pairSnapshots(const std::vector<Snapshot>& lefts,
+                                                         const std::vector<Snapshot>& rights,
+                                                         long long tolerance);
+
+//snap_0 and snap_1 files of one snapshot are never further apart, ms
+const long long snapshotPairTolerance = 20;
 
+//files are paired by timestamp in their names, so order of lists does not matter, files without
+//timestamp or partner are not used and listed as unpaired in calibration data. Lists of equal length
+//without any timestamp are paired by index.
+//images of both cameras are detected concurrently and only pairs with chessboard found on both sides
+//and size of first used pair are used, reprojection error of each pair is stored with calibration data
 bool stereoCalibrate(int squareSize,
                      int wcount,
                      int hcount,
                      const std::vector<std::string>& filesLeft,
                      const std::vector<std::string>& filesRight,
-                     const std::string& fileName);
+                     const std::string& fileName,
+                     DetectionMode mode = DETECTION_DOWNSCALED,
+                     const ProgressCallback& progress = ProgressCallback());
 
 struct CameraParameter
 {
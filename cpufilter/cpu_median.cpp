@@ -0,0 +1,295 @@
+#include "cpu_median.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CPU_FILTER_X86
+#include <immintrin.h>
+#endif
+
+namespace cpu {
+
+namespace {
+
+size_t medianRowScalar(const unsigned char* const* rows, size_t n, size_t begin, size_t end, unsigned char* out) {
+    unsigned char values[Median3DFilter::maxDepth] = {0};
+    for (size_t x = begin; x < end; ++x) {
+        for (size_t i = 0; i < n; ++i) {
+            values[i] = rows[i][x];
+        }
+        std::nth_element(values, values + n / 2, values + n);
+        out[x] = values[n / 2];
+    }
+    return end;
+}
+
+#ifdef CPU_FILTER_X86
+// Odd-even transposition sorting network, each lane is an independent pixel
+__attribute__((target("sse2")))
+size_t medianRowSSE2(const unsigned char* const* rows, size_t n, size_t begin, size_t end, unsigned char* out) {
+    __m128i v[Median3DFilter::maxDepth];
+    size_t x = begin;
+    for (; x + 16 <= end; x += 16) {
+        for (size_t i = 0; i < n; ++i) {
+            v[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[i] + x));
+        }
+        for (size_t pass = 0; pass < n; ++pass) {
+            for (size_t i = pass & 1; i + 1 < n; i += 2) {
+                __m128i a = v[i];
+                v[i] = _mm_min_epu8(a, v[i + 1]);
+                v[i + 1] = _mm_max_epu8(a, v[i + 1]);
+            }
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), v[n / 2]);
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+size_t medianRowAVX2(const unsigned char* const* rows, size_t n, size_t begin, size_t end, unsigned char* out) {
+    __m256i v[Median3DFilter::maxDepth];
+    size_t x = begin;
+    for (; x + 32 <= end; x += 32) {
+        for (size_t i = 0; i < n; ++i) {
+            v[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rows[i] + x));
+        }
+        for (size_t pass = 0; pass < n; ++pass) {
+            for (size_t i = pass & 1; i + 1 < n; i += 2) {
+                __m256i a = v[i];
+                v[i] = _mm256_min_epu8(a, v[i + 1]);
+                v[i + 1] = _mm256_max_epu8(a, v[i + 1]);
+            }
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x), v[n / 2]);
+    }
+    return x;
+}
+
+bool hasAVX2() {
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+// Incremental update of per pixel sorted windows, ranks[k] points to k-th smallest values of the row.
+// When 'remove' is set one occurrence of oldRow value leaves the window, then newRow value is inserted,
+// both steps are branchless so each lane is an independent pixel
+size_t updateRowScalar(unsigned char* const* ranks, const unsigned char* oldRow, const unsigned char* newRow,
+                       size_t n, bool remove, size_t begin, size_t end) {
+    unsigned char t[Median3DFilter::maxDepth] = {0};
+    const size_t m = remove ? n - 1 : n;
+    for (size_t x = begin; x < end; ++x) {
+        if (remove) {
+            bool found = false;
+            for (size_t k = 0; k < m; ++k) {
+                found = found || ranks[k][x] == oldRow[x];
+                t[k] = found ? ranks[k + 1][x] : ranks[k][x];
+            }
+        } else {
+            for (size_t k = 0; k < m; ++k) {
+                t[k] = ranks[k][x];
+            }
+        }
+        const unsigned char v = newRow[x];
+        if (m == 0) {
+            ranks[0][x] = v;
+            continue;
+        }
+        ranks[0][x] = std::min(t[0], v);
+        for (size_t k = 1; k < m; ++k) {
+            ranks[k][x] = std::max(t[k - 1], std::min(t[k], v));
+        }
+        ranks[m][x] = std::max(t[m - 1], v);
+    }
+    return end;
+}
+
+#ifdef CPU_FILTER_X86
+__attribute__((target("sse2")))
+size_t updateRowSSE2(unsigned char* const* ranks, const unsigned char* oldRow, const unsigned char* newRow,
+                     size_t n, bool remove, size_t begin, size_t end) {
+    __m128i t[Median3DFilter::maxDepth];
+    const size_t m = remove ? n - 1 : n;
+    size_t x = begin;
+    for (; x + 16 <= end; x += 16) {
+        if (remove) {
+            const __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(oldRow + x));
+            __m128i found = _mm_setzero_si128();
+            __m128i cur = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranks[0] + x));
+            for (size_t k = 0; k < m; ++k) {
+                const __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranks[k + 1] + x));
+                found = _mm_or_si128(found, _mm_cmpeq_epi8(cur, o));
+                t[k] = _mm_or_si128(_mm_and_si128(found, next), _mm_andnot_si128(found, cur));
+                cur = next;
+            }
+        } else {
+            for (size_t k = 0; k < m; ++k) {
+                t[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ranks[k] + x));
+            }
+        }
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(newRow + x));
+        if (m == 0) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ranks[0] + x), v);
+            continue;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ranks[0] + x), _mm_min_epu8(t[0], v));
+        for (size_t k = 1; k < m; ++k) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(ranks[k] + x),
+                             _mm_max_epu8(t[k - 1], _mm_min_epu8(t[k], v)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(ranks[m] + x), _mm_max_epu8(t[m - 1], v));
+    }
+    return x;
+}
+
+__attribute__((target("avx2")))
+size_t updateRowAVX2(unsigned char* const* ranks, const unsigned char* oldRow, const unsigned char* newRow,
+                     size_t n, bool remove, size_t begin, size_t end) {
+    __m256i t[Median3DFilter::maxDepth];
+    const size_t m = remove ? n - 1 : n;
+    size_t x = begin;
+    for (; x + 32 <= end; x += 32) {
+        if (remove) {
+            const __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(oldRow + x));
+            __m256i found = _mm256_setzero_si256();
+            __m256i cur = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ranks[0] + x));
+            for (size_t k = 0; k < m; ++k) {
+                const __m256i next = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ranks[k + 1] + x));
+                found = _mm256_or_si256(found, _mm256_cmpeq_epi8(cur, o));
+                t[k] = _mm256_blendv_epi8(cur, next, found);
+                cur = next;
+            }
+        } else {
+            for (size_t k = 0; k < m; ++k) {
+                t[k] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ranks[k] + x));
+            }
+        }
+        const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(newRow + x));
+        if (m == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(ranks[0] + x), v);
+            continue;
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ranks[0] + x), _mm256_min_epu8(t[0], v));
+        for (size_t k = 1; k < m; ++k) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(ranks[k] + x),
+                                _mm256_max_epu8(t[k - 1], _mm256_min_epu8(t[k], v)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(ranks[m] + x), _mm256_max_epu8(t[m - 1], v));
+    }
+    return x;
+}
+#endif
+
+void updateRow(unsigned char* const* ranks, const unsigned char* oldRow, const unsigned char* newRow,
+               size_t n, bool remove, size_t width) {
+    size_t x = 0;
+#ifdef CPU_FILTER_X86
+    if (hasAVX2()) {
+        x = updateRowAVX2(ranks, oldRow, newRow, n, remove, x, width);
+    }
+    x = updateRowSSE2(ranks, oldRow, newRow, n, remove, x, width);
+#endif
+    updateRowScalar(ranks, oldRow, newRow, n, remove, x, width);
+}
+
+void medianRow(const unsigned char* const* rows, size_t n, size_t width, unsigned char* out) {
+    size_t x = 0;
+#ifdef CPU_FILTER_X86
+    if (hasAVX2()) {
+        x = medianRowAVX2(rows, n, x, width, out);
+    }
+    x = medianRowSSE2(rows, n, x, width, out);
+#endif
+    medianRowScalar(rows, n, x, width, out);
+}
+
+}
+
+Median3DFilter::Median3DFilter(size_t width, size_t height, size_t depth, Mode mode)
+    : width(width)
+    , height(height)
+    , depth(depth)
+    , frameBytesNumber(width * height)
+    , framesCount(0)
+    , nextFrame(0)
+    , mode(mode) {
+    if (depth < 1 || depth > maxDepth) {
+        throw std::invalid_argument("Median filter depth should be in range [1, 64]");
+    }
+    if (width < 1 || height < 1) {
+        throw std::invalid_argument("Median filter frame size should not be empty");
+    }
+    frames.resize(frameBytesNumber * depth);
+    if (mode == Incremental) {
+        windows.resize(frameBytesNumber * depth);
+    }
+}
+
+Median3DFilter::~Median3DFilter() {
+}
+
+void Median3DFilter::pushFrame(const unsigned char *data) {
+    if (mode == Incremental) {
+        // oldest frame leaves the window and the new one enters, before it is overwritten in the ring
+        const unsigned char* oldFrame = frames.data() + nextFrame * frameBytesNumber;
+        const size_t n = framesCount;
+        const bool full = framesCount == depth;
+        const long rows = static_cast<long>(height);
+
+        #pragma omp parallel for schedule(static)
+        for (long y = 0; y < rows; ++y) {
+            unsigned char* rankPtrs[maxDepth];
+            const size_t offset = static_cast<size_t>(y) * width;
+            for (size_t k = 0; k < depth; ++k) {
+                rankPtrs[k] = windows.data() + k * frameBytesNumber + offset;
+            }
+            updateRow(rankPtrs, oldFrame + offset, data + offset, n, full, width);
+        }
+    }
+
+    std::memcpy(frames.data() + nextFrame * frameBytesNumber, data, frameBytesNumber);
+    nextFrame = (nextFrame + 1) % depth;
+    framesCount = std::min(framesCount + 1, depth);
+}
+
+void Median3DFilter::getFilteredFrame(unsigned char *data) {
+    if (framesCount == 0) {
+        return;
+    }
+
+    const size_t n = framesCount;
+
+    if (mode == Incremental) {
+        // windows are kept sorted, median is just the middle rank plane
+        std::memcpy(data, windows.data() + (n / 2) * frameBytesNumber, frameBytesNumber);
+        return;
+    }
+
+    const long rows = static_cast<long>(height);
+
+    #pragma omp parallel for schedule(static)
+    for (long y = 0; y < rows; ++y) {
+        const unsigned char* rowPtrs[maxDepth];
+        const size_t offset = static_cast<size_t>(y) * width;
+        for (size_t i = 0; i < n; ++i) {
+            rowPtrs[i] = frames.data() + i * frameBytesNumber + offset;
+        }
+        medianRow(rowPtrs, n, width, data + offset);
+    }
+}
+
+size_t Median3DFilter::getWidth() const {
+    return width;
+}
+
+size_t Median3DFilter::getHeight() const {
+    return height;
+}
+
+Median3DFilter::Mode Median3DFilter::getMode() const {
+    return mode;
+}
+
+}
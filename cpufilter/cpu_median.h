@@ -0,0 +1,47 @@
+#ifndef CPU_MEDIAN_H
+#define CPU_MEDIAN_H
+
+#include <vector>
+#include <cstddef>
+
+namespace cpu {
+
+// Temporal median over last 'depth' frames, same interface as cuda::Median3DFilter
+class Median3DFilter final {
+  public:
+    enum Mode {
+        // sorts whole window of every pixel on each request
+        SortingNetwork,
+        // keeps sorted window of every pixel, updated on push
+        Incremental
+    };
+
+    Median3DFilter(size_t width, size_t height, size_t depth, Mode mode = SortingNetwork);
+    ~Median3DFilter();
+
+    void pushFrame(const unsigned char *data);
+
+    void getFilteredFrame(unsigned char* data);
+
+    size_t getWidth() const;
+    size_t getHeight() const;
+    Mode getMode() const;
+
+    static const size_t maxDepth = 64;
+
+  private:
+    size_t width;
+    size_t height;
+    size_t depth;
+    size_t frameBytesNumber;
+    size_t framesCount;
+    size_t nextFrame;
+    Mode mode;
+    std::vector<unsigned char> frames;
+    // per pixel sorted values, k-th plane holds k-th smallest value of every pixel
+    std::vector<unsigned char> windows;
+};
+
+}
+
+#endif // CPU_MEDIAN_H
@@ -0,0 +1,55 @@
+#include "cpuusage.h"
+
+#include <time.h>
+
+CpuUsageCounter::CpuUsageCounter()
+    : cpuTime(0)
+    , lastThreadTime(0)
+    , lastCpuTime(0)
+    , lastWallTime(std::chrono::steady_clock::now())
+{
+}
+
+unsigned long long CpuUsageCounter::threadTime()
+{
+    struct timespec ts;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+    {
+        return 0;
+    }
+    return static_cast<unsigned long long>(ts.tv_sec) * 1000000ULL +
+           static_cast<unsigned long long>(ts.tv_nsec) / 1000ULL;
+}
+
+void CpuUsageCounter::startThread()
+{
+    lastThreadTime = threadTime();
+}
+
+void CpuUsageCounter::update()
+{
+    auto time = threadTime();
+    if (time > lastThreadTime)
+    {
+        cpuTime += time - lastThreadTime;
+    }
+    lastThreadTime = time;
+}
+
+double CpuUsageCounter::getUsage()
+{
+    std::unique_lock<std::mutex> lock(usageGuard);
+    auto now = std::chrono::steady_clock::now();
+    auto wall = std::chrono::duration_cast<std::chrono::microseconds>(now - lastWallTime).count();
+    unsigned long long cpu = cpuTime;
+
+    double usage = 0;
+    if (wall > 0)
+    {
+        usage = 100. * static_cast<double>(cpu - lastCpuTime) / static_cast<double>(wall);
+    }
+
+    lastCpuTime = cpu;
+    lastWallTime = now;
+    return usage;
+}
@@ -0,0 +1,39 @@
+#ifndef CPUUSAGE_H
+#define CPUUSAGE_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+
+//accumulates CPU time of a worker thread to report its load
+class CpuUsageCounter
+{
+public:
+    CpuUsageCounter();
+
+    CpuUsageCounter(const CpuUsageCounter&) = delete;
+
+    CpuUsageCounter& operator=(const CpuUsageCounter&) = delete;
+
+    //should be called from measured thread when it starts
+    void startThread();
+
+    //should be called from measured thread, adds its CPU time since previous call
+    void update();
+
+    //percent of one core used since previous call
+    double getUsage();
+
+private:
+    static unsigned long long threadTime();
+
+private:
+    std::atomic<unsigned long long> cpuTime; //us
+    unsigned long long lastThreadTime;
+
+    std::mutex usageGuard;
+    unsigned long long lastCpuTime;
+    std::chrono::steady_clock::time_point lastWallTime;
+};
+
+#endif // CPUUSAGE_H
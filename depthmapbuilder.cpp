@@ -1,13 +1,26 @@
 #include "depthmapbuilder.h"
+#include "sgmstereomatcher.h"
+#include "threadpool.h"
+#include "stagestats.h"
+#include "pipelinetrace.h"
 
 #include <opencv2/photo/cuda.hpp>
 
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
 
 
 DepthMapBuilder::DepthMapBuilder()
     : leftSource(nullptr)
     , rightSource(nullptr)
-    , hasUndistort(false)
+    , frameRate(0)
+    , matchingTime(0)
+    , filterLatency(0)
+    , qualityMode(false)
+    , stop(false)
 {
     int sgbmWinSize = 3;
     int cn = 1;
@@ -41,34 +54,35 @@ DepthMapBuilder::~DepthMapBuilder()
     stopProcessing();
 }
 
-void DepthMapBuilder::setLeftSource(FrameSource &source)
+void DepthMapBuilder::setLeftSource(Rectifier &source)
 {
     std::unique_lock<std::mutex> lock(processGuard);
     leftSource = &source;
 }
 
-void DepthMapBuilder::setRightSource(FrameSource &source)
+void DepthMapBuilder::setRightSource(Rectifier &source)
 {
     std::unique_lock<std::mutex> lock(processGuard);
     rightSource = &source;
 }
 
-void DepthMapBuilder::getFrame(cv::Mat& map)
+void DepthMapBuilder::getFrame(FramePtr& map, FrameInfo& info)
 {
     std::unique_lock<std::mutex> lock(outGuard);
-    depthMap.copyTo(map);
+    map = depthMap;
+    info = depthMapInfo;
 }
 
-void DepthMapBuilder::getPoints(std::vector<cv::Vec3f> &pts, std::vector<cv::Vec3b>& colors) const
+std::shared_ptr<const DepthPoints> DepthMapBuilder::getPoints() const
 {
     std::unique_lock<std::mutex> lock(outGuard);
-    pts = points3d;
-    colors = pointsColor;
+    return points;
 }
 
 void DepthMapBuilder::startProcessing()
 {
     stop = false;
+    synchronizer.reset();
     thread = std::move(std::thread(std::bind(&DepthMapBuilder::processing,this)));
 }
 
@@ -85,7 +99,7 @@ void DepthMapBuilder::stopProcessing()
     }
 }
 
-bool DepthMapBuilder::loadCalibrationParams(const std::__cxx11::string &fileName)
+bool DepthMapBuilder::loadCalibrationParams(const std::string &fileName)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     try
@@ -99,7 +113,6 @@ bool DepthMapBuilder::loadCalibrationParams(const std::__cxx11::string &fileName
         storage["T"] >> T;
         storage["E"] >> E;
         storage["F"] >> F;
-        hasUndistort = true;
         return true;
     }
     catch(...)
@@ -118,7 +131,7 @@ void DepthMapBuilder::setMinDisparity(int minDisparity)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setMinDisparity(minDisparity);
-    rightStereoMatcher->setMinDisparity(minDisparity);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getNumDisparities() const
@@ -131,7 +144,7 @@ void DepthMapBuilder::setNumDisparities(int numDisparities)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setNumDisparities(numDisparities);
-    rightStereoMatcher->setNumDisparities(numDisparities);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getBlockSize() const
@@ -144,7 +157,7 @@ void DepthMapBuilder::setBlockSize(int blockSize)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setBlockSize(blockSize);
-    rightStereoMatcher->setBlockSize(blockSize);
+    updateRightMatcher();
 }
 
 int  DepthMapBuilder::getP1() const
@@ -157,7 +170,7 @@ void DepthMapBuilder::setP1(int p1)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setP1(p1);
-    //rightStereoMatcher->setP1(p1);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getP2() const
@@ -170,7 +183,7 @@ void DepthMapBuilder::setP2(int p2)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setP2(p2);
-    //rightStereoMatcher->setP2(p2);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getDisp12MaxDiff() const
@@ -183,7 +196,7 @@ void DepthMapBuilder::setDisp12MaxDiff(int disp12MaxDiff)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setDisp12MaxDiff(disp12MaxDiff);
-    rightStereoMatcher->setDisp12MaxDiff(disp12MaxDiff);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getPreFilterCap() const
@@ -196,7 +209,7 @@ void DepthMapBuilder::setPreFilterCap(int preFilterCap)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setPreFilterCap(preFilterCap);
-    //rightStereoMatcher->setPreFilterCap(preFilterCap);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getUniquenessRatio() const
@@ -209,7 +222,7 @@ void DepthMapBuilder::setUniquenessRatio(int uniquenessRatio)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setUniquenessRatio(uniquenessRatio);
-    //rightStereoMatcher->setUniquenessRatio(uniquenessRatio);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getSpeckleWindowSize() const
@@ -222,7 +235,7 @@ void DepthMapBuilder::setSpeckleWindowSize(int speckleWindowSize)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setSpeckleWindowSize(speckleWindowSize);
-    rightStereoMatcher->setSpeckleWindowSize(speckleWindowSize);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getSpeckleRange() const
@@ -235,7 +248,7 @@ void DepthMapBuilder::setSpeckleRange(int speckleRange)
 {
     std::unique_lock<std::mutex> lock(outGuard);
     leftStereoMatcher->setSpeckleRange(speckleRange);
-    rightStereoMatcher->setSpeckleRange(speckleRange);
+    updateRightMatcher();
 }
 
 int DepthMapBuilder::getMode() const
@@ -247,30 +260,242 @@ int DepthMapBuilder::getMode() const
 void DepthMapBuilder::setMode(int mode)
 {
     std::unique_lock<std::mutex> lock(outGuard);
-    leftStereoMatcher->setMode(mode);
-    //rightStereoMatcher->setMode(mode);
+    const bool census = mode == SgmStereoMatcher::MODE_CENSUS;
+    const bool censusNow = leftStereoMatcher->getMode() == SgmStereoMatcher::MODE_CENSUS;
+    if (census == censusNow)
+    {
+        leftStereoMatcher->setMode(mode);
+        updateRightMatcher();
+        return;
+    }
+
+    //penalties have different units, so each matcher starts with its own defaults
+    cv::Ptr<cv::StereoSGBM> matcher;
+    if (census)
+    {
+        matcher = SgmStereoMatcher::create(leftStereoMatcher->getMinDisparity(),
+                                           leftStereoMatcher->getNumDisparities());
+    }
+    else
+    {
+        const int blockSize = 3;
+        matcher = cv::StereoSGBM::create(leftStereoMatcher->getMinDisparity(),
+                                         leftStereoMatcher->getNumDisparities(),
+                                         blockSize, 8*blockSize*blockSize, 32*blockSize*blockSize,
+                                         1, 63, 10, 100, 32, mode);
+    }
+    matcher->setDisp12MaxDiff(leftStereoMatcher->getDisp12MaxDiff());
+    matcher->setUniquenessRatio(leftStereoMatcher->getUniquenessRatio());
+    matcher->setSpeckleWindowSize(leftStereoMatcher->getSpeckleWindowSize());
+    matcher->setSpeckleRange(leftStereoMatcher->getSpeckleRange());
+
+    //matcher is replaced, processing thread keeps its own reference to the old one until frame is done
+    leftStereoMatcher = matcher;
+    updateRightMatcher();
+    if (tiledStereoMatcher)
+    {
+        tiledStereoMatcher = TiledStereoMatcher::create(leftStereoMatcher, tiledStereoMatcher->getBandsCount());
+    }
+    if (pyramidStereoMatcher)
+    {
+        pyramidStereoMatcher = PyramidStereoMatcher::create(leftStereoMatcher, pyramidStereoMatcher->getLevels(),
+                                                            pyramidStereoMatcher->getSearchRadius());
+    }
 }
 
-void DepthMapBuilder::getLeftMapping(const cv::Size &imgSize, cv::Mat &mapx, cv::Mat &mapy, cv::Rect& roi)
+void DepthMapBuilder::updateRightMatcher()
 {
+    //right matcher searches negated range and WLS filter keeps range and block size it was created with,
+    //so both are rebuilt, processing thread keeps old ones until frame is done
+    wls_filter = cv::ximgproc::createDisparityWLSFilter(leftStereoMatcher);
+    if (leftStereoMatcher->getMode() == SgmStereoMatcher::MODE_CENSUS)
+    {
+        //right view is still matched by OpenCV SGBM with the same disparity range
+        const int blockSize = 3;
+        rightStereoMatcher = cv::ximgproc::createRightMatcher(
+                    cv::StereoSGBM::create(leftStereoMatcher->getMinDisparity(), leftStereoMatcher->getNumDisparities(),
+                                           blockSize, 8*blockSize*blockSize, 32*blockSize*blockSize));
+    }
+    else
+    {
+        rightStereoMatcher = cv::ximgproc::createRightMatcher(leftStereoMatcher);
+    }
+}
+
+int DepthMapBuilder::getBandsCount() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return tiledStereoMatcher ? tiledStereoMatcher->getBandsCount() : 0;
+}
+
+void DepthMapBuilder::setBandsCount(int count)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    if (count <= 0)
+    {
+        tiledStereoMatcher.release();
+    }
+    else if (tiledStereoMatcher)
+    {
+        tiledStereoMatcher->setBandsCount(count);
+    }
+    else
+    {
+        tiledStereoMatcher = TiledStereoMatcher::create(leftStereoMatcher, count);
+    }
+}
+
+int DepthMapBuilder::getPyramidLevels() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return pyramidStereoMatcher ? pyramidStereoMatcher->getLevels() : 0;
+}
+
+void DepthMapBuilder::setPyramidLevels(int levels)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    if (levels <= 0)
+    {
+        pyramidStereoMatcher.release();
+    }
+    else if (pyramidStereoMatcher)
+    {
+        pyramidStereoMatcher->setLevels(levels);
+    }
+    else
+    {
+        pyramidStereoMatcher = PyramidStereoMatcher::create(leftStereoMatcher, levels);
+    }
+}
+
+bool DepthMapBuilder::isTemporalReuse() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return static_cast<bool>(temporalStereoMatcher);
+}
+
+void DepthMapBuilder::setTemporalReuse(bool reuse)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    if (!reuse)
+    {
+        temporalStereoMatcher.release();
+    }
+    else if (!temporalStereoMatcher)
+    {
+        temporalStereoMatcher = TemporalStereoMatcher::create(leftStereoMatcher);
+    }
+}
+
+TemporalStereoMatcher::Statistics DepthMapBuilder::getReuseStatistics() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return temporalStereoMatcher ? temporalStereoMatcher->getStatistics() : TemporalStereoMatcher::Statistics();
+}
+
+double DepthMapBuilder::getFrameRate() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return frameRate;
+}
+
+bool DepthMapBuilder::isQualityMode() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return qualityMode;
+}
+
+void DepthMapBuilder::setQualityMode(bool quality)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    qualityMode = quality;
+    filterLatency = 0;
+}
+
+double DepthMapBuilder::getMatchingTime() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return matchingTime;
+}
+
+double DepthMapBuilder::getFilterLatency() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return filterLatency;
+}
+
+cv::Rect DepthMapBuilder::getRoi() const
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    return roi;
+}
+
+void DepthMapBuilder::setRoi(const cv::Rect& rect)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    roi = rect.area() > 0 ? rect : cv::Rect();
+    //reused tiles are tied to the matched region
+    if (temporalStereoMatcher)
+    {
+        temporalStereoMatcher->reset();
+    }
+}
+
+void DepthMapBuilder::resetRoi()
+{
+    setRoi(cv::Rect());
+}
+
+int DepthMapBuilder::getSyncTolerance() const
+{
+    return static_cast<int>(synchronizer.getTolerance() / 1000);
+}
+
+void DepthMapBuilder::setSyncTolerance(int tolerance)
+{
+    synchronizer.setTolerance(static_cast<unsigned long long>(std::max(tolerance, 0)) * 1000);
+}
+
+StereoSynchronizer::Statistics DepthMapBuilder::getSyncStatistics() const
+{
+    return synchronizer.getStatistics();
+}
+
+double DepthMapBuilder::getCpuUsage()
+{
+    return cpuUsage.getUsage();
+}
+
+FramePool::Statistics DepthMapBuilder::getPoolStatistics() const
+{
+    return framePool.getStatistics();
+}
+
+RectifyMap DepthMapBuilder::getLeftMapping(const cv::Size &imgSize)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
     initCalibration(imgSize);
-    mapLeftx.copyTo(mapx);
-    mapLefty.copyTo(mapy);
-    roi = commonRoi;
+    RectifyMap map;
+    map.init(cameraMatrixLeft, distCoeffsLeft, R1, P1, imgSize, commonRoi);
+    return map;
 }
 
-void DepthMapBuilder::getRightMapping(const cv::Size &imgSize, cv::Mat &mapx, cv::Mat &mapy, cv::Rect& roi)
+RectifyMap DepthMapBuilder::getRightMapping(const cv::Size &imgSize)
 {
+    std::unique_lock<std::mutex> lock(outGuard);
     initCalibration(imgSize);
-    mapRightx.copyTo(mapx);
-    mapRighty.copyTo(mapy);
-    roi = commonRoi;
+    RectifyMap map;
+    map.init(cameraMatrixRight, distCoeffsRight, R2, P2, imgSize, commonRoi);
+    return map;
 }
 
 void DepthMapBuilder::saveDepthMap(const std::string &fileName)
 {
     std::unique_lock<std::mutex> lock(outGuard);
-    cv::imwrite(fileName, depthMap);
+    if (depthMap)
+    {
+        cv::imwrite(fileName, *depthMap);
+    }
 }
 
 cv::Rect computeROI(cv::Size2i src_sz, cv::Ptr<cv::StereoMatcher> matcher_instance)
@@ -291,131 +516,297 @@ cv::Rect computeROI(cv::Size2i src_sz, cv::Ptr<cv::StereoMatcher> matcher_instan
     return r;
 }
 
-void DepthMapBuilder::processing()
+DepthMapBuilder::MatchState::MatchState()
+    : wlsFilter(false)
+    , leftMs(0)
+    , totalMs(0)
+{
+}
+
+void DepthMapBuilder::takeSettings(MatchState& state)
 {
-    bool undistortInitialized = false;
+    state.Q = Q;
+    if (pyramidStereoMatcher)
+    {
+        state.matcher = pyramidStereoMatcher;
+    }
+    else if (tiledStereoMatcher)
+    {
+        state.matcher = tiledStereoMatcher;
+    }
+    else
+    {
+        state.matcher = leftStereoMatcher;
+    }
+    if (temporalStereoMatcher)
+    {
+        temporalStereoMatcher->setMatcher(state.matcher);
+        state.matcher = temporalStereoMatcher;
+    }
+    state.wls = wls_filter;
+    state.rightMatcher = rightStereoMatcher;
+    state.wlsFilter = qualityMode;
+    state.roi = roi;
+}
 
-    cv::Mat leftImgColor;
-    cv::Mat leftImg;
-    cv::Mat rightImg;
-    cv::Mat leftDisp;
-    cv::Mat rightDisp;
+void DepthMapBuilder::matchPair(MatchState& state, const cv::Mat& left, const cv::Mat& leftGray,
+                                const cv::Mat& right, const cv::Mat& rightGray)
+{
+    cv::Mat leftImgColor = left;
+    cv::Mat leftImg = left;
+    cv::Mat rightImg = right;
 
-    cv::Mat image3d;
+    //sources already rectified frames and made gray versions if calibration is loaded
+    if (!leftGray.empty())
+    {
+        leftImg = leftGray;
+    }
+    else if (leftImg.channels() == 3)
+    {
+        ScopedStageTimer timer(StageStatistics::STAGE_COLOR);
+        cv::cvtColor(leftImg, state.leftGray, CV_BGR2GRAY);
+        leftImg = state.leftGray;
+    }
+
+    if (!rightGray.empty())
+    {
+        rightImg = rightGray;
+    }
+    else if (rightImg.channels() == 3)
+    {
+        ScopedStageTimer timer(StageStatistics::STAGE_COLOR);
+        cv::cvtColor(rightImg, state.rightGray, CV_BGR2GRAY);
+        rightImg = state.rightGray;
+    }
+
+    //only region of interest is matched, widened to the left by disparity range and by half of block
+    const int shift = state.matcher->getNumDisparities() + state.matcher->getMinDisparity();
+    cv::Rect roiRect = state.roi & cv::Rect(0, 0, leftImg.cols, leftImg.rows);
+    cv::Rect matchRect(0, 0, leftImg.cols, leftImg.rows);
+    if (roiRect.area() > 0)
+    {
+        const int border = state.matcher->getBlockSize() / 2;
+        cv::Point tl(roiRect.x - std::max(shift, 0) - border, roiRect.y - border);
+        cv::Point br(roiRect.br().x + border, roiRect.br().y + border);
+        matchRect = cv::Rect(tl, br) & matchRect;
+        leftImg = leftImg(matchRect);
+        rightImg = rightImg(matchRect);
+        leftImgColor = leftImgColor(matchRect);
+    }
+
+    //in quality mode right view is matched concurrently on second thread for WLS filter
+    const auto matchStart = std::chrono::steady_clock::now();
+    state.leftMs = 0;
+    if (state.wlsFilter)
+    {
+        if (!state.pool)
+        {
+            state.pool.reset(new ThreadPool(2));
+        }
+        std::vector<ThreadPool::Task> tasks;
+        tasks.push_back([&](size_t)
+        {
+            state.matcher->compute(leftImg, rightImg, state.leftDisp);
+            state.leftMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - matchStart).count();
+        });
+        tasks.push_back([&](size_t)
+        {
+            state.rightMatcher->compute(rightImg, leftImg, state.rightDisp);
+        });
+        state.pool->run(tasks);
+    }
+    else
+    {
+        state.matcher->compute(leftImg, rightImg, state.leftDisp);
+        state.leftMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - matchStart).count();
+    }
+/*
+    cv::Rect rcCrop = cv::getValidDisparityROI(leftRoi,
+                             rightRoi,
+                             leftStereoMatcher->getMinDisparity(),
+                             leftStereoMatcher->getNumDisparities(),
+                             leftStereoMatcher->getBlockSize());                       
+    cv::Mat visDisp;
+    //cv::ximgproc::getDisparityVis(leftDisp(rcCrop), visDisp);
+    leftDisp.convertTo(visDisp, CV_8U, 255/(leftStereoMatcher->getNumDisparities()*16.));
+
+    //cv::equalizeHist(visDisp,visDisp);
+
+    std::unique_lock<std::mutex> lock(outGuard);
+    visDisp.copyTo(depthMap);
+
+*/
+
+    cv::Mat filteredDisp = state.leftDisp;
+    if (state.wlsFilter)
+    {
+        const double lambda = 8000.0;
+        const double sigma = 1.5;
+        state.wls->setLambda(lambda);
+        state.wls->setSigmaColor(sigma);
+        state.wls->filter(state.leftDisp, leftImg, filteredDisp, state.rightDisp);
+    }
+    state.totalMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - matchStart).count();
+    StageStatistics::record(StageStatistics::STAGE_MATCH, static_cast<unsigned long long>(state.totalMs * 1000));
+    PipelineTrace::record(StageStatistics::getStageName(StageStatistics::STAGE_MATCH), matchStart, std::chrono::steady_clock::now());
+
+    //cv::reprojectImageTo3D(filteredDisp, image3d, Q, true, CV_32F);
+
+    /*cv::Rect rcCrop = cv::getValidDisparityROI(leftRoi,
+                             rightRoi,
+                             leftStereoMatcher->getMinDisparity(),
+                             leftStereoMatcher->getNumDisparities(),
+                             leftStereoMatcher->getBlockSize());*/
+
+    cv::Rect rcCrop(shift,
+                    0,
+                    leftImg.cols - shift,
+                    leftImg.rows);
+    if (roiRect.area() > 0)
+    {
+        rcCrop = cv::Rect(roiRect.x - matchRect.x, roiRect.y - matchRect.y, roiRect.width, roiRect.height);
+    }
+
+    state.disparity = filteredDisp;
+    state.color = leftImgColor;
+    state.crop = rcCrop & cv::Rect(0, 0, filteredDisp.cols, filteredDisp.rows);
+    state.origin = matchRect.tl();
+}
+
+void DepthMapBuilder::processing()
+{
+    MatchState state;
+    FramePtr leftFrame;
+    FramePtr rightFrame;
+    FramePtr leftFrameGray;
+    FramePtr rightFrameGray;
+    FramePtr leftPair;
+    FramePtr rightPair;
+    FramePtr leftPairGray;
+    FramePtr rightPairGray;
+    FrameInfo leftInfo;
+    FrameInfo rightInfo;
+    std::chrono::steady_clock::time_point lastFrameTime;
 
     unsigned long long numErrors = std::numeric_limits<unsigned long long>::max();
+    unsigned long long leftGeneration = 0;
+    unsigned long long rightGeneration = 0;
+
+    cpuUsage.startThread();
+    PipelineTrace::setThreadName("depth");
 
     bool done = false;
     while(!done)
     {
+        cpuUsage.update();
         {
             std::unique_lock<std::mutex> lock(processGuard);
             if (rightSource != nullptr && leftSource!= nullptr)
             {
-                leftSource->getFrame(leftImg);
-                rightSource->getFrame(rightImg);
+                //sleep until sources publish frames which were not seen yet
+                auto generation = leftSource->waitFrame(leftGeneration, 100);
+                if (generation != leftGeneration)
+                {
+                    leftGeneration = generation;
+                    leftSource->getFrame(leftFrame, leftFrameGray, leftInfo);
+                    synchronizer.pushLeft(leftFrame, leftFrameGray, leftInfo);
+                }
+
+                generation = rightSource->waitFrame(rightGeneration, 100);
+                if (generation != rightGeneration)
+                {
+                    rightGeneration = generation;
+                    rightSource->getFrame(rightFrame, rightFrameGray, rightInfo);
+                    synchronizer.pushRight(rightFrame, rightFrameGray, rightInfo);
+                }
+            }
+            else
+            {
+                lock.unlock();
+                std::this_thread::sleep_for(std::chrono::milliseconds(100));
             }
         }
 
+        if (!synchronizer.getPair(leftPair, rightPair, leftPairGray, rightPairGray, leftInfo, rightInfo))
+        {
+            leftPair.reset();
+            rightPair.reset();
+        }
+
         {
             std::unique_lock<std::mutex> lock(outGuard);
             done = stop;
+            takeSettings(state);
         }
 
-        if (!leftImg.empty() && !rightImg.empty())
+        if (leftPair && rightPair && !leftPair->empty() && !rightPair->empty())
         {
-            if (!undistortInitialized && hasUndistort)
+            ScopedTraceEvent frameEvent("depth frame", leftInfo);
+            //pair frames are shared with other consumers, only read them
+            try
             {
-                initCalibration(leftImg.size());
-                undistortInitialized = true;
+                matchPair(state, *leftPair, leftPairGray ? *leftPairGray : cv::Mat(),
+                          *rightPair, rightPairGray ? *rightPairGray : cv::Mat());
             }
-
-            leftImg.copyTo(leftImgColor);
-
-            if (leftImg.channels() == 3)
+            catch(std::exception& err)
             {
-                cv::cvtColor(leftImg, leftImg, CV_BGR2GRAY);
+                //matcher rejects some settings typed by user, depth thread keeps running
+                std::cerr << err.what() << std::endl;
+                continue;
             }
-            if (rightImg.channels() == 3)
-            {
-                cv::cvtColor(rightImg, rightImg, CV_BGR2GRAY);
-            }            
-
-
-            //undistort
-            if (hasUndistort)
-            {
-                cv::remap(leftImg, leftImg, mapLeftx, mapLefty, cv::INTER_LINEAR);
-                leftImg = leftImg(commonRoi);
-
-                cv::remap(leftImgColor, leftImgColor, mapLeftx, mapLefty, cv::INTER_LINEAR);
-                leftImgColor = leftImgColor(commonRoi);
-
-                cv::remap(rightImg, rightImg, mapRightx, mapRighty, cv::INTER_LINEAR);
-                rightImg = rightImg(commonRoi);
-            }
-
-            leftStereoMatcher->compute(leftImg, rightImg, leftDisp);
-/*
-            cv::Rect rcCrop = cv::getValidDisparityROI(leftRoi,
-                                     rightRoi,
-                                     leftStereoMatcher->getMinDisparity(),
-                                     leftStereoMatcher->getNumDisparities(),
-                                     leftStereoMatcher->getBlockSize());                       
-            cv::Mat visDisp;
-            //cv::ximgproc::getDisparityVis(leftDisp(rcCrop), visDisp);
-            leftDisp.convertTo(visDisp, CV_8U, 255/(leftStereoMatcher->getNumDisparities()*16.));
-
-            //cv::equalizeHist(visDisp,visDisp);
-
-            std::unique_lock<std::mutex> lock(outGuard);
-            visDisp.copyTo(depthMap);
-
-*/
-
-           // rightStereoMatcher->compute(rightImg, leftImg, rightDisp);
-
-            const double lambda = 8000.0;
-            const double sigma = 1.5;            
-            wls_filter->setLambda(lambda);
-            wls_filter->setSigmaColor(sigma);
 
-            cv::Mat filteredDisp = leftDisp;
-            //wls_filter->filter(leftDisp,leftImg,filteredDisp,rightDisp);
+            fillPoints(state.disparity, state.Q, state.color, state.crop, state.origin);
 
-            //cv::reprojectImageTo3D(filteredDisp, image3d, Q, true, CV_32F);
+            cv::Mat filteredDisp = state.disparity(state.crop);
 
-            /*cv::Rect rcCrop = cv::getValidDisparityROI(leftRoi,
-                                     rightRoi,
-                                     leftStereoMatcher->getMinDisparity(),
-                                     leftStereoMatcher->getNumDisparities(),
-                                     leftStereoMatcher->getBlockSize());*/
-
-            int shift = leftStereoMatcher->getNumDisparities() + leftStereoMatcher->getMinDisparity();
-            cv::Rect rcCrop(shift,
-                            0,
-                            leftImg.cols - shift,
-                            leftImg.rows);
-
-            fillPoints(filteredDisp, Q, leftImgColor, rcCrop);
-
-            filteredDisp = filteredDisp(rcCrop);
-
-            cv::Mat visDisp;
+            auto visDisp = framePool.acquire(filteredDisp.rows, filteredDisp.cols, CV_8U);
             //cv::ximgproc::getDisparityVis(filteredDisp, visDisp);
-            filteredDisp.convertTo(visDisp, CV_8U, 255/(leftStereoMatcher->getNumDisparities()*16.));
+            filteredDisp.convertTo(*visDisp, CV_8U, 255/(state.matcher->getNumDisparities()*16.));
             //cv::equalizeHist(visDisp,visDisp);
 
-            std::unique_lock<std::mutex> lock(outGuard);
-            visDisp.copyTo(depthMap);
-
+            {
+                std::unique_lock<std::mutex> lock(outGuard);
+                depthMap = visDisp;
+                depthMapInfo = leftInfo;
+                //smoothed over about ten frames
+                auto now = std::chrono::steady_clock::now();
+                if (lastFrameTime != std::chrono::steady_clock::time_point())
+                {
+                    const double interval = std::chrono::duration<double>(now - lastFrameTime).count();
+                    if (interval > 0)
+                    {
+                        frameRate = frameRate == 0 ? 1. / interval : 0.9 * frameRate + 0.1 / interval;
+                    }
+                }
+                lastFrameTime = now;
+                matchingTime = matchingTime == 0 ? state.leftMs : 0.9 * matchingTime + 0.1 * state.leftMs;
+                filterLatency = state.wlsFilter ? 0.9 * filterLatency + 0.1 * (state.totalMs - state.leftMs) : 0;
+            }
+            notifyFrame();
         }
     }
 }
 
+DepthPoints::DepthPoints()
+    : count(0)
+{
+}
+
+void DepthPoints::reserve(size_t capacity)
+{
+    if (x.size() < capacity)
+    {
+        x.resize(capacity);
+        y.resize(capacity);
+        z.resize(capacity);
+        blue.resize(capacity);
+        green.resize(capacity);
+        red.resize(capacity);
+    }
+}
+
 void DepthMapBuilder::initCalibration(const cv::Size &imgSize)
 {
-    cv::Mat R1, R2, P1, P2;
     cv::stereoRectify(cameraMatrixLeft, distCoeffsLeft,
                      cameraMatrixRight, distCoeffsRight,
                      imgSize,
@@ -424,57 +815,185 @@ void DepthMapBuilder::initCalibration(const cv::Size &imgSize)
                      imgSize, &leftRoi, &rightRoi);
 
     commonRoi = leftRoi & rightRoi;
-
-    initUndistortRectifyMap(cameraMatrixLeft, distCoeffsLeft, R1, P1, imgSize, CV_32FC1, mapLeftx, mapLefty);
-    initUndistortRectifyMap(cameraMatrixRight, distCoeffsRight, R2, P2, imgSize, CV_32FC1, mapRightx, mapRighty);
 }
 
-void DepthMapBuilder::fillPoints(const cv::Mat &disp, const cv::Mat &Q, const cv::Mat &color, const cv::Rect& rc )
+namespace
 {
-    cv::Mat disp32F;
-    disp.convertTo(disp32F, CV_32F, 1./16);
 
-    cv::Mat Q_32F;
-    Q.convertTo(Q_32F,CV_32F);
-    cv::Mat_<float> vec(4,1);
+//reprojects rows of the crop rectangle, each row writes its points at the row start in output buffer,
+//so rows are independent and compacted afterwards
+class ReprojectBody : public cv::ParallelLoopBody
+{
+public:
+    ReprojectBody(const cv::Mat& disp, const cv::Mat& color, const cv::Rect& rc, const cv::Point& origin,
+                  const cv::Matx44d& Q, DepthPoints& points, std::vector<int>& rowCounts)
+        : disp(disp)
+        , color(color)
+        , rc(rc)
+        , origin(origin)
+        , points(points)
+        , rowCounts(rowCounts)
+    {
+        //stereoRectify produces Q with only these elements non zero, the rest of product is skipped
+        q00 = static_cast<float>(Q(0, 0));
+        q03 = static_cast<float>(Q(0, 3));
+        q11 = static_cast<float>(Q(1, 1));
+        q13 = static_cast<float>(Q(1, 3));
+        q23 = static_cast<float>(Q(2, 3));
+        q32 = static_cast<float>(Q(3, 2));
+        q33 = static_cast<float>(Q(3, 3));
+    }
 
-    std::unique_lock<std::mutex> lock(outGuard);
-    points3d.clear();
-    pointsColor.clear();
-    cv::Vec3f point;
-    for (int y = 0; y < disp32F.rows; ++y)
+    void operator()(const cv::Range& range) const override
     {
-        for (int x = 0; x < disp32F.cols; ++x)
+        const int width = rc.width;
+        std::vector<float> xs(width), ys(width), zs(width);
+        std::vector<unsigned char> valid(width);
+        float* px = xs.data();
+        float* py = ys.data();
+        float* pz = zs.data();
+        unsigned char* pv = valid.data();
+
+        for (int row = range.start; row < range.end; ++row)
         {
-            if (rc.contains(cv::Point(x,y)))
+            const int y = rc.y + row;
+            const short* d = disp.ptr<short>(y) + rc.x;
+            const float fy = ((origin.y + y) * q11 + q13);
+            const float x0 = static_cast<float>(origin.x + rc.x);
+
+            #pragma omp simd
+            for (int i = 0; i < width; ++i)
             {
-                vec(0)=x;
-                vec(1)=y;
-                vec(2)=disp32F.at<float>(y,x);
-                vec(3)=1;
+                const float dv = d[i] * (1.f / 16);
+                const float w = 1.f / (q32 * dv + q33);
+                const float X = ((x0 + i) * q00 + q03) * w;
+                const float Y = fy * w;
+                const float Z = q23 * w;
+                px[i] = X;
+                py[i] = Y;
+                pz[i] = Z;
+                //far points only, near zero values are reprojection of invalid disparities
+                pv[i] = (d[i] != 0) & ((std::fabs(X) > 10) | (std::fabs(Y) > 10) | (std::fabs(Z) > 10));
+            }
 
-                if(vec(2) != 0)
+            const size_t offset = static_cast<size_t>(row) * width;
+            const cv::Vec3b* c = color.ptr<cv::Vec3b>(y) + rc.x;
+            int count = 0;
+            for (int i = 0; i < width; ++i)
+            {
+                if (pv[i])
                 {
-                    vec = Q_32F*vec;
-                    vec /= vec(3);
-
-                    if(fabs(vec(0))>10 || fabs(vec(1))>10 || fabs(vec(2))>10)
-                    {
-                        point[0] = vec(0);
-                        point[1] = vec(1);
-                        point[2] = vec(2);
-
-                        points3d.push_back(point);
-                        pointsColor.push_back(color.at<cv::Vec3b>(y,x));
-                    }
+                    const size_t j = offset + count++;
+                    points.x[j] = px[i];
+                    points.y[j] = py[i];
+                    points.z[j] = pz[i];
+                    points.blue[j] = c[i][0];
+                    points.green[j] = c[i][1];
+                    points.red[j] = c[i][2];
                 }
             }
-            /*cv::Vec3f p = image3d.at<cv::Vec3f>(y,x);
-            if (p[2] != 10000 && rc.contains(cv::Point(x,y)))
-            {
-                points3d.push_back(p);
-                pointsColor.push_back(color.at<cv::Vec3b>(y,x));
-            }*/
+            rowCounts[row] = count;
         }
     }
+
+private:
+    const cv::Mat& disp;
+    const cv::Mat& color;
+    cv::Rect rc;
+    cv::Point origin;
+    DepthPoints& points;
+    std::vector<int>& rowCounts;
+    float q00, q03, q11, q13, q23, q32, q33;
+};
+
+template<class T>
+void compactRows(std::vector<T>& values, const std::vector<int>& rowCounts, size_t rowSize)
+{
+    size_t dst = 0;
+    for (size_t row = 0; row < rowCounts.size(); ++row)
+    {
+        const size_t src = row * rowSize;
+        if (dst != src)
+        {
+            std::memmove(values.data() + dst, values.data() + src, rowCounts[row] * sizeof(T));
+        }
+        dst += rowCounts[row];
+    }
+}
+
+bool reprojectPoints(const cv::Mat &disp, const cv::Mat &Q, const cv::Mat &color, const cv::Rect& rc,
+                     const cv::Point& origin, DepthPoints& points)
+{
+    cv::Rect crop = rc & cv::Rect(0, 0, disp.cols, disp.rows);
+    if (Q.empty() || crop.area() <= 0 || disp.type() != CV_16S || color.type() != CV_8UC3)
+    {
+        return false;
+    }
+
+    ScopedStageTimer timer(StageStatistics::STAGE_REPROJECT);
+    points.reserve(crop.area());
+
+    std::vector<int> rowCounts(crop.height, 0);
+    cv::parallel_for_(cv::Range(0, crop.height), ReprojectBody(disp, color, crop, origin, cv::Matx44d(Q), points, rowCounts));
+
+    compactRows(points.x, rowCounts, crop.width);
+    compactRows(points.y, rowCounts, crop.width);
+    compactRows(points.z, rowCounts, crop.width);
+    compactRows(points.blue, rowCounts, crop.width);
+    compactRows(points.green, rowCounts, crop.width);
+    compactRows(points.red, rowCounts, crop.width);
+    points.count = 0;
+    for (int count : rowCounts)
+    {
+        points.count += count;
+    }
+    return true;
+}
+
+}
+
+void DepthMapBuilder::fillPoints(const cv::Mat &disp, const cv::Mat &Q, const cv::Mat &color, const cv::Rect& rc,
+                                 const cv::Point& origin)
+{
+    //reuse previous buffer if nobody else holds it
+    std::shared_ptr<DepthPoints> buffer;
+    if (sparePoints && sparePoints.use_count() == 1)
+    {
+        buffer.swap(sparePoints);
+    }
+    else
+    {
+        buffer = std::make_shared<DepthPoints>();
+    }
+
+    if (!reprojectPoints(disp, Q, color, rc, origin, *buffer))
+    {
+        sparePoints = buffer;
+        return;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(outGuard);
+        points.swap(buffer);
+    }
+    sparePoints = buffer;
+}
+
+bool DepthMapBuilder::computeDepth(const cv::Mat& left, const cv::Mat& right, cv::Mat& disparity, DepthPoints& points)
+{
+    if (left.empty() || right.empty() || left.size() != right.size())
+    {
+        return false;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(outGuard);
+        takeSettings(syncState);
+    }
+
+    matchPair(syncState, left, cv::Mat(), right, cv::Mat());
+    syncState.disparity(syncState.crop).copyTo(disparity);
+    points.count = 0;
+    reprojectPoints(syncState.disparity, syncState.Q, syncState.color, syncState.crop, syncState.origin, points);
+    return true;
 }
@@ -2,12 +2,37 @@
 #define DEPTHMAPBUILDER_H
 
 #include "framesource.h"
+#include "stereosynchronizer.h"
+#include "cpuusage.h"
+#include "rectifier.h"
+#include "tiledstereomatcher.h"
+#include "pyramidstereomatcher.h"
+#include "temporalstereomatcher.h"
+#include "threadpool.h"
 
 #include <opencv2/opencv.hpp>
 #include <opencv2/ximgproc/disparity_filter.hpp>
 
+#include <memory>
 #include <mutex>
 #include <thread>
+#include <atomic>
+
+//reprojected points as structure of arrays, only first count elements are valid
+struct DepthPoints
+{
+    DepthPoints();
+
+    void reserve(size_t capacity);
+
+    size_t count;
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+    std::vector<unsigned char> blue;
+    std::vector<unsigned char> green;
+    std::vector<unsigned char> red;
+};
 
 class DepthMapBuilder : public FrameSource
 {
@@ -21,12 +46,14 @@ public:
     DepthMapBuilder& operator=(const DepthMapBuilder&) = delete;
 
 
-    void setLeftSource(FrameSource& source);
-    void setRightSource(FrameSource& source);
+    //sources provide frames already rectified with mappings from getLeftMapping/getRightMapping
+    void setLeftSource(Rectifier& source);
+    void setRightSource(Rectifier& source);
 
-    void getFrame(cv::Mat& map) override;
+    void getFrame(FramePtr& map, FrameInfo& info) override;
 
-    void getPoints(std::vector<cv::Vec3f>& pts, std::vector<cv::Vec3b> &colors) const;
+    //points of last depth map, published buffer is never modified
+    std::shared_ptr<const DepthPoints> getPoints() const;
 
     void startProcessing();
 
@@ -68,50 +95,145 @@ public:
     int getMode() const;
     void setMode(int mode);
 
+    //number of bands matched concurrently, 0 - whole frame is matched at once
+    int getBandsCount() const;
+    void setBandsCount(int count);
+
+    //coarse-to-fine matching from 1/2^levels resolution, 0 - off, takes precedence over bands
+    int getPyramidLevels() const;
+    void setPyramidLevels(int levels);
+
+    //disparity of tiles unchanged since last matching is reused
+    bool isTemporalReuse() const;
+    void setTemporalReuse(bool reuse);
+
+    TemporalStereoMatcher::Statistics getReuseStatistics() const;
+
+    //depth maps per second
+    double getFrameRate() const;
+
+    //right view is matched concurrently with left one and both are combined by WLS filter
+    bool isQualityMode() const;
+    void setQualityMode(bool quality);
+
+    //left view matching time and latency added by quality mode, ms
+    double getMatchingTime() const;
+    double getFilterLatency() const;
+
+    //only this rectangle of rectified left frame is matched and reprojected, empty - whole frame
+    cv::Rect getRoi() const;
+    void setRoi(const cv::Rect& rect);
+    void resetRoi();
+
+    //max capture time difference of stereo pair, ms
+    int getSyncTolerance() const;
+    void setSyncTolerance(int tolerance);
+
+    StereoSynchronizer::Statistics getSyncStatistics() const;
+
+    double getCpuUsage();
+
+    FramePool::Statistics getPoolStatistics() const;
+
     //calibration
 
-    void getLeftMapping(const cv::Size& imgSize, cv::Mat& mapx, cv::Mat& mapy, cv::Rect& roi);
-    void getRightMapping(const cv::Size& imgSize, cv::Mat& mapx, cv::Mat& mapy, cv::Rect& roi);
+    RectifyMap getLeftMapping(const cv::Size& imgSize);
+    RectifyMap getRightMapping(const cv::Size& imgSize);
 
     void saveDepthMap(const std::string& fileName);
 
+    //matches already rectified pair on the calling thread with current settings, without startProcessing,
+    //disparity is CV_16S cropped like published depth map, one builder is not for concurrent calls
+    bool computeDepth(const cv::Mat& left, const cv::Mat& right, cv::Mat& disparity, DepthPoints& points);
+
 private:
 
+    //matcher settings and buffers of one matching thread
+    struct MatchState
+    {
+        MatchState();
+
+        cv::Mat Q;
+        cv::Ptr<cv::StereoSGBM> matcher;
+        cv::Ptr<cv::StereoMatcher> rightMatcher;
+        cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls;
+        bool wlsFilter;
+        cv::Rect roi;
+
+        cv::Mat leftGray;
+        cv::Mat rightGray;
+        cv::Mat leftDisp;
+        cv::Mat rightDisp;
+        std::unique_ptr<ThreadPool> pool;
+
+        //result, crop is valid part of disparity, origin is position of disparity in rectified frame
+        cv::Mat disparity;
+        cv::Mat color;
+        cv::Rect crop;
+        cv::Point origin;
+        double leftMs;
+        double totalMs;
+    };
+
     void processing();
 
+    //outGuard should be locked
+    void takeSettings(MatchState& state);
+
+    //outGuard should be locked
+    void updateRightMatcher();
+
+    //gray images may be empty, then they are converted from color ones
+    void matchPair(MatchState& state, const cv::Mat& left, const cv::Mat& leftGray,
+                   const cv::Mat& right, const cv::Mat& rightGray);
+
     void initCalibration(const cv::Size& imgSize);
 
-    void fillPoints(const cv::Mat& disp, const cv::Mat& image3d, const cv::Mat &color, const cv::Rect& rc );
+    //origin is position of disp in rectified frame, reprojection needs frame coordinates
+    void fillPoints(const cv::Mat& disp, const cv::Mat& image3d, const cv::Mat &color, const cv::Rect& rc,
+                    const cv::Point& origin);
 
 private:
     cv::Ptr<cv::StereoSGBM> leftStereoMatcher;
+    cv::Ptr<TiledStereoMatcher> tiledStereoMatcher;
+    cv::Ptr<PyramidStereoMatcher> pyramidStereoMatcher;
+    cv::Ptr<TemporalStereoMatcher> temporalStereoMatcher;
     cv::Ptr<cv::StereoMatcher> rightStereoMatcher;
     cv::Ptr<cv::ximgproc::DisparityWLSFilter> wls_filter;
 
-    FrameSource* leftSource;
-    FrameSource* rightSource;
-    cv::Mat depthMap;
-    std::vector<cv::Vec3f> points3d;
-    std::vector<cv::Vec3b> pointsColor;
+    Rectifier* leftSource;
+    Rectifier* rightSource;
+    StereoSynchronizer synchronizer;
+    FramePtr depthMap;
+    FrameInfo depthMapInfo;
+    double frameRate;
+    double matchingTime;
+    double filterLatency;
+    bool qualityMode;
+    cv::Rect roi;
+    FramePool framePool;
+    std::shared_ptr<DepthPoints> points;
+    std::shared_ptr<DepthPoints> sparePoints;
+    MatchState syncState;
 
     mutable std::mutex outGuard;
     std::mutex processGuard;
 
     std::thread thread;
-    bool stop;
+    std::atomic<bool> stop;
+
+    CpuUsageCounter cpuUsage;
 
     cv::Mat cameraMatrixLeft;
     cv::Mat cameraMatrixRight;
     cv::Mat distCoeffsLeft;
     cv::Mat distCoeffsRight;
     cv::Mat R, T, E, F;
-    cv::Mat mapLeftx, mapLefty;
-    cv::Mat mapRightx, mapRighty;
+    cv::Mat R1, R2, P1, P2;
     cv::Rect leftRoi;
     cv::Rect rightRoi;
     cv::Rect commonRoi;
     cv::Mat Q;
-    bool hasUndistort;
 };
 
 #endif // DEPTHMAPBUILDER_H
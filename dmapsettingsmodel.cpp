@@ -47,7 +47,17 @@ QVariant DMapSettingsModel::data(const QModelIndex &index, int role) const
             case 9:
                 return QString("speckleRange");
             case 10:
-                return QString("mode");
+                return QString("mode (4: census SGM)");
+            case 11:
+                return QString("syncTolerance(ms)");
+            case 12:
+                return QString("bands (0: off)");
+            case 13:
+                return QString("pyramid levels (0: off)");
+            case 14:
+                return QString("temporal reuse (0: off)");
+            case 15:
+                return QString("WLS filter (0: off)");
             }
         }
         //values
@@ -77,6 +87,16 @@ QVariant DMapSettingsModel::data(const QModelIndex &index, int role) const
                 return dmapBuilder->getSpeckleRange();
             case 10:
                 return dmapBuilder->getMode();
+            case 11:
+                return dmapBuilder->getSyncTolerance();
+            case 12:
+                return dmapBuilder->getBandsCount();
+            case 13:
+                return dmapBuilder->getPyramidLevels();
+            case 14:
+                return dmapBuilder->isTemporalReuse() ? 1 : 0;
+            case 15:
+                return dmapBuilder->isQualityMode() ? 1 : 0;
             }
         }
     }
@@ -142,6 +162,21 @@ bool DMapSettingsModel::setData(const QModelIndex & index, const QVariant & valu
             case 10:
                 dmapBuilder->setMode(ival);
                 break;
+            case 11:
+                dmapBuilder->setSyncTolerance(ival);
+                break;
+            case 12:
+                dmapBuilder->setBandsCount(ival);
+                break;
+            case 13:
+                dmapBuilder->setPyramidLevels(ival);
+                break;
+            case 14:
+                dmapBuilder->setTemporalReuse(ival != 0);
+                break;
+            case 15:
+                dmapBuilder->setQualityMode(ival != 0);
+                break;
             }
         }
     }
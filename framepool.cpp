@@ -0,0 +1,102 @@
+#include "framepool.h"
+
+#include <algorithm>
+
+FramePool::Statistics::Statistics()
+    : capacity(0)
+    , inUse(0)
+    , highWater(0)
+    , acquired(0)
+    , exhausted(0)
+{
+}
+
+FramePool::Storage::Storage(size_t capacity)
+{
+    stat.capacity = std::max<size_t>(capacity, 1);
+    freeFrames.reserve(stat.capacity);
+}
+
+void FramePool::Storage::release(cv::Mat* frame)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    if (stat.inUse > 0)
+    {
+        --stat.inUse;
+    }
+    if (freeFrames.size() < stat.capacity)
+    {
+        freeFrames.push_back(*frame);
+    }
+    delete frame;
+}
+
+FramePool::FramePool(size_t capacity)
+    : storage(std::make_shared<Storage>(capacity))
+{
+}
+
+void FramePool::reserve(int rows, int cols, int type)
+{
+    std::unique_lock<std::mutex> lock(storage->guard);
+    while (storage->freeFrames.size() + storage->stat.inUse < storage->stat.capacity)
+    {
+        storage->freeFrames.push_back(cv::Mat());
+    }
+    for (auto& frame : storage->freeFrames)
+    {
+        frame.create(rows, cols, type);
+    }
+}
+
+std::shared_ptr<cv::Mat> FramePool::acquire(int rows, int cols, int type)
+{
+    std::unique_ptr<cv::Mat> frame(new cv::Mat());
+    {
+        std::unique_lock<std::mutex> lock(storage->guard);
+        auto& freeFrames = storage->freeFrames;
+        if (!freeFrames.empty())
+        {
+            //prefer buffer of the same format to avoid reallocation
+            auto i = std::find_if(freeFrames.begin(), freeFrames.end(), [&](const cv::Mat& m)
+            {
+                return m.rows == rows && m.cols == cols && m.type() == type;
+            });
+            if (i == freeFrames.end())
+            {
+                i = freeFrames.end() - 1;
+            }
+            *frame = *i;
+            freeFrames.erase(i);
+        }
+        else
+        {
+            ++storage->stat.exhausted;
+        }
+        ++storage->stat.acquired;
+        ++storage->stat.inUse;
+        storage->stat.highWater = std::max(storage->stat.highWater, storage->stat.inUse);
+    }
+
+    frame->create(rows, cols, type);
+
+    std::weak_ptr<Storage> weakStorage(storage);
+    return std::shared_ptr<cv::Mat>(frame.release(), [weakStorage](cv::Mat* m)
+    {
+        auto storage = weakStorage.lock();
+        if (storage)
+        {
+            storage->release(m);
+        }
+        else
+        {
+            delete m;
+        }
+    });
+}
+
+FramePool::Statistics FramePool::getStatistics() const
+{
+    std::unique_lock<std::mutex> lock(storage->guard);
+    return storage->stat;
+}
@@ -0,0 +1,57 @@
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//published frames are immutable and shared between pipeline stages by pointer
+typedef std::shared_ptr<const cv::Mat> FramePtr;
+
+//fixed set of preallocated frame buffers, buffer returns to pool when last reference is released
+class FramePool
+{
+public:
+    struct Statistics
+    {
+        Statistics();
+
+        size_t capacity;
+        size_t inUse;
+        size_t highWater;
+        unsigned long long acquired;
+        unsigned long long exhausted; //allocations made because all buffers were in use
+    };
+
+    explicit FramePool(size_t capacity = 8);
+
+    FramePool(const FramePool&) = delete;
+
+    FramePool& operator=(const FramePool&) = delete;
+
+    //allocates all buffers for given frame format
+    void reserve(int rows, int cols, int type);
+
+    //returns writable buffer of given format, it should not be changed after publishing
+    std::shared_ptr<cv::Mat> acquire(int rows, int cols, int type);
+
+    Statistics getStatistics() const;
+
+private:
+    struct Storage
+    {
+        Storage(size_t capacity);
+
+        void release(cv::Mat* frame);
+
+        std::mutex guard;
+        std::vector<cv::Mat> freeFrames;
+        Statistics stat;
+    };
+
+    std::shared_ptr<Storage> storage;
+};
+
+#endif // FRAMEPOOL_H
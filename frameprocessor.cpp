@@ -1,6 +1,6 @@
 #include "frameprocessor.h"
-
-#include <deque>
+#include "stagestats.h"
+#include "pipelinetrace.h"
 
 FrameProcessor::FrameProcessor()
     : outScaleFactor(1)
@@ -9,6 +9,8 @@ FrameProcessor::FrameProcessor()
     , outUndistort(false)
     , outDrawLines(false)
     , outNoiseFilter(false)
+    , outNoiseFilterGpu(false)
+    , frameGeneration(0)
     , stop(false)    
 {
 
@@ -19,39 +21,58 @@ FrameProcessor::~FrameProcessor()
     stopProcessing();
 }
 
-void FrameProcessor::setFrame(const cv::Mat frame)
+void FrameProcessor::setFrame(const FramePtr& frame, const FrameInfo& info)
 {
-    std::unique_lock<std::mutex> lock(processGuard);
-    this->frame = frame;
+    {
+        std::unique_lock<std::mutex> lock(processGuard);
+        this->frame = frame;
+        this->frameInfo = info;
+        ++frameGeneration;
+    }
+    frameArrived.notify_one();
 }
 
-void FrameProcessor::getFrame(cv::Mat &frame)
+void FrameProcessor::getFrame(FramePtr& frame, FrameInfo& info)
 {
     std::unique_lock<std::mutex> lock(outGuard);
-    outFrame.copyTo(frame);
+    frame = outFrame;
+    info = outFrameInfo;
 }
 
 void FrameProcessor::processing()
 {
-    std::vector<cv::Mat> channels(3);
-    cv::Mat tmp;
+    FrameInfo inInfo;
     double scaleFactor = 1;
     int channel = -1;
     bool gray = false;
     bool undistort = false;
     bool drawLines = false;
     bool noiseFilter = false;
-    cv::Mat frameUndistort;
+    bool noiseFilterGpu = false;
+    unsigned long long processedGeneration = 0;
+
+    cpuUsage.startThread();
+    PipelineTrace::setThreadName("processor");
 
     bool done =false;
     while(!done)
     {
+        cpuUsage.update();
+        FramePtr inFrame;
         {
+            //sleep until camera delivers new frame, so each frame is processed only once
             std::unique_lock<std::mutex> lock(processGuard);
-            if (!frame.empty())
+            frameArrived.wait_for(lock, std::chrono::milliseconds(100), [&]()
             {
-                frame.copyTo(tmp);
+                return frameGeneration != processedGeneration || stop;
+            });
+
+            if (frameGeneration != processedGeneration)
+            {
+                inFrame = frame;
+                inInfo = frameInfo;
             }
+            processedGeneration = frameGeneration;
         }
         {
             std::unique_lock<std::mutex> lock(outGuard);
@@ -61,59 +82,94 @@ void FrameProcessor::processing()
             undistort = outUndistort;
             drawLines = outDrawLines;
             noiseFilter = outNoiseFilter;
+            noiseFilterGpu = outNoiseFilterGpu;
             done = stop;
         }
 
-        if (!tmp.empty())
+        if (inFrame && !inFrame->empty())
         {
+            ScopedTraceEvent frameEvent("process frame", inInfo);
+            //input frame is shared with other consumers, so each step writes to its own pooled buffer
+            cv::Mat tmp = *inFrame;
+            std::shared_ptr<cv::Mat> tmpBuffer;
+
             if (undistort)
             {
                 std::unique_lock<std::mutex> lock(outGuard);
                 if (!cameraMatrix.empty())
                 {
-                    cv::undistort(tmp, frameUndistort, cameraMatrix, distCoeffs);
+                    auto dst = framePool.acquire(tmp.rows, tmp.cols, tmp.type());
+                    ScopedStageTimer timer(StageStatistics::STAGE_RECTIFY);
+                    cv::undistort(tmp, *dst, cameraMatrix, distCoeffs);
+                    tmp = *dst;
+                    tmpBuffer = dst;
                 }
-                else if (!mapx.empty())
-                {
-                    cv::remap(tmp, frameUndistort, mapx, mapy, cv::INTER_LINEAR);
-                    frameUndistort = frameUndistort(remapRoi);
-                }
-                frameUndistort.copyTo(tmp);
             }
 
             if (gray)
             {
-                cv::cvtColor(tmp, tmp, CV_BGR2GRAY);
+                auto dst = framePool.acquire(tmp.rows, tmp.cols, CV_8UC1);
+                ScopedStageTimer timer(StageStatistics::STAGE_COLOR);
+                cv::cvtColor(tmp, *dst, CV_BGR2GRAY);
+                tmp = *dst;
+                tmpBuffer = dst;
             }
             else
             {
-                cv::cvtColor(tmp, tmp, CV_BGR2RGB);
+                auto dst = framePool.acquire(tmp.rows, tmp.cols, CV_8UC3);
+                {
+                    ScopedStageTimer timer(StageStatistics::STAGE_COLOR);
+                    cv::cvtColor(tmp, *dst, CV_BGR2RGB);
+                }
+                tmp = *dst;
+                tmpBuffer = dst;
                 if (scaleFactor != 1)
                 {
-                    cv::resize(tmp, tmp, cv::Size(0,0), scaleFactor, scaleFactor, cv::INTER_NEAREST);
+                    cv::Size size(cvRound(tmp.cols * scaleFactor), cvRound(tmp.rows * scaleFactor));
+                    dst = framePool.acquire(size.height, size.width, tmp.type());
+                    cv::resize(tmp, *dst, size, 0, 0, cv::INTER_NEAREST);
+                    tmp = *dst;
+                    tmpBuffer = dst;
                 }
                 if (channel >= 0 && channel < tmp.channels())
                 {
-                    channels.clear();
-                    cv::split(tmp, channels);
-                    channels[channel].copyTo(tmp);
+                    dst = framePool.acquire(tmp.rows, tmp.cols, CV_8UC1);
+                    cv::extractChannel(tmp, *dst, channel);
+                    tmp = *dst;
+                    tmpBuffer = dst;
                 }
             }
 
             //noise filter
             if (tmp.channels() == 1 && noiseFilter)
             {
+                ScopedStageTimer timer(StageStatistics::STAGE_NOISE_FILTER);
+                if (noiseFilterGpu)
+                {
+#ifdef WITH_CUDA
+                    if (!cudaFilter3d ||
+                         cudaFilter3d->getWidth() != static_cast<size_t>(tmp.cols) ||
+                         cudaFilter3d->getHeight() != static_cast<size_t>(tmp.rows)){
+                        cudaFilter3d.reset(new cuda::Median3DFilter(tmp.cols, tmp.rows, 8, 15));
+                    }
 
-                if (!filter3d ||
-                     filter3d->getWidth() != tmp.cols ||
-                     filter3d->getHeight() != tmp.rows){
-                    filter3d.reset(new cuda::Median3DFilter(tmp.cols, tmp.rows, 8, 15));
-                }
+                    cudaFilter3d->pushFrame(tmp.data);
 
-                filter3d->pushFrame(tmp.data);
+                    cudaFilter3d->getFilteredFrame(tmp.data);
+#endif
+                }
+                else
+                {
+                    if (!filter3d ||
+                         filter3d->getWidth() != static_cast<size_t>(tmp.cols) ||
+                         filter3d->getHeight() != static_cast<size_t>(tmp.rows)){
+                        filter3d.reset(new cpu::Median3DFilter(tmp.cols, tmp.rows, 15, cpu::Median3DFilter::Incremental));
+                    }
 
-                filter3d->getFilteredFrame(tmp.data);
+                    filter3d->pushFrame(tmp.data);
 
+                    filter3d->getFilteredFrame(tmp.data);
+                }
             }
 
             //draw center lines
@@ -151,8 +207,10 @@ void FrameProcessor::processing()
             }
             {
                 std::unique_lock<std::mutex> lock(outGuard);
-                tmp.copyTo(outFrame);
+                outFrame = tmpBuffer;
+                outFrameInfo = inInfo;
             }
+            notifyFrame();
         }
     }
 }
@@ -166,9 +224,10 @@ void FrameProcessor::startProcessing()
 void FrameProcessor::stopProcessing()
 {
     {
-        std::unique_lock<std::mutex> lock(outGuard);
+        std::unique_lock<std::mutex> lock(processGuard);
         stop = true;
     }
+    frameArrived.notify_all();
 
     if (thread.joinable())
     {
@@ -212,6 +271,21 @@ void FrameProcessor::setDrawLines(bool drawLines)
     outDrawLines = drawLines;
 }
 
+void FrameProcessor::setNoiseFilterOnGpu(bool gpu)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    outNoiseFilterGpu = gpu && isGpuNoiseFilterAvailable();
+}
+
+bool FrameProcessor::isGpuNoiseFilterAvailable()
+{
+#ifdef WITH_CUDA
+    return true;
+#else
+    return false;
+#endif
+}
+
 bool FrameProcessor::isUndistortApplied() const
 {
     return outUndistort;
@@ -227,6 +301,11 @@ bool FrameProcessor::isDrawLines() const
     return outDrawLines;
 }
 
+bool FrameProcessor::isNoiseFilterOnGpu() const
+{
+    return outNoiseFilterGpu;
+}
+
 bool FrameProcessor::loadCalibrationParams(const std::string &fileName)
 {
     std::unique_lock<std::mutex> lock(outGuard);
@@ -243,10 +322,12 @@ bool FrameProcessor::loadCalibrationParams(const std::string &fileName)
     }
 }
 
-void FrameProcessor::setUndistortMappings(const cv::Mat &mapx, const cv::Mat &mapy, const cv::Rect &roi)
+double FrameProcessor::getCpuUsage()
 {
-    std::unique_lock<std::mutex> lock(outGuard);
-    this->mapx = mapx.clone();
-    this->mapy = mapy.clone();
-    this->remapRoi = roi;
+    return cpuUsage.getUsage();
+}
+
+FramePool::Statistics FrameProcessor::getPoolStatistics() const
+{
+    return framePool.getStatistics();
 }
@@ -2,7 +2,11 @@
 #define FRAMEPROCESSOR_H
 
 #include "framesource.h"
+#include "cpuusage.h"
+#include "cpufilter/cpu_median.h"
+#ifdef WITH_CUDA
 #include "cufilter/cu_median.h"
+#endif
 
 #include <opencv2/opencv.hpp>
 
@@ -10,6 +14,8 @@
 #include <mutex>
 #include <thread>
 #include <future>
+#include <atomic>
+#include <condition_variable>
 
 class FrameProcessor : public FrameSource
 {
@@ -22,9 +28,9 @@ public:
 
     FrameProcessor& operator=(const FrameProcessor&) = delete;
 
-    void setFrame(const cv::Mat frame);
+    void setFrame(const FramePtr& frame, const FrameInfo& info);
 
-    void getFrame(cv::Mat& frame) override;
+    void getFrame(FramePtr& frame, FrameInfo& info) override;
 
     void startProcessing();
 
@@ -42,15 +48,24 @@ public:
 
     void setDrawLines(bool drawLines);
 
+    //GPU filter is used only if application was built with CUDA
+    void setNoiseFilterOnGpu(bool gpu);
+
+    static bool isGpuNoiseFilterAvailable();
+
     bool isUndistortApplied() const;
 
     bool isNoiseFilterApplied() const;
 
     bool isDrawLines() const;
 
+    bool isNoiseFilterOnGpu() const;
+
     bool loadCalibrationParams(const std::string& fileName);
 
-    void setUndistortMappings(const cv::Mat& mapx, const cv::Mat& mapy, const cv::Rect& roi);
+    double getCpuUsage();
+
+    FramePool::Statistics getPoolStatistics() const;
 
 private:
 
@@ -64,22 +79,30 @@ private:
     bool outUndistort;
     bool outDrawLines;
     bool outNoiseFilter;
+    bool outNoiseFilterGpu;
     cv::Mat cameraMatrix;
     cv::Mat distCoeffs;
-    cv::Mat mapx;
-    cv::Mat mapy;
-    cv::Rect remapRoi;
 
-    cv::Mat frame;
-    cv::Mat outFrame;
+    FramePtr frame;
+    FrameInfo frameInfo;
+    unsigned long long frameGeneration;
+    std::condition_variable frameArrived;
+    FramePtr outFrame;
+    FrameInfo outFrameInfo;
+    FramePool framePool;
 
     std::mutex outGuard;
     std::mutex processGuard;
 
     std::thread thread;
-    bool stop;
+    std::atomic<bool> stop;
+
+    CpuUsageCounter cpuUsage;
 
-    std::unique_ptr<cuda::Median3DFilter> filter3d;
+    std::unique_ptr<cpu::Median3DFilter> filter3d;
+#ifdef WITH_CUDA
+    std::unique_ptr<cuda::Median3DFilter> cudaFilter3d;
+#endif
 
 };
 
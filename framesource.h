@@ -1,14 +1,69 @@
 #ifndef FRAMESOURCE_H
 #define FRAMESOURCE_H
 
+#include "framepool.h"
+
 #include <opencv2/opencv.hpp>
 
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+
+struct FrameInfo
+{
+    FrameInfo() : timestamp(0), sequence(0) {}
+    FrameInfo(unsigned long long timestamp, unsigned sequence) : timestamp(timestamp), sequence(sequence) {}
+
+    //capture time in microseconds, as reported by V4L2 driver
+    unsigned long long timestamp;
+    unsigned sequence;
+};
+
 class FrameSource
 {
 public:
+    FrameSource() : generation(0) {}
+
     virtual ~FrameSource() {}
 
-    virtual void getFrame(cv::Mat& frame) = 0;
+    FrameSource(const FrameSource&) = delete;
+
+    FrameSource& operator=(const FrameSource&) = delete;
+
+    //returned frame is shared with other consumers and should not be modified
+    virtual void getFrame(FramePtr& frame, FrameInfo& info) = 0;
+
+    //number of frames published so far
+    unsigned long long getGeneration() const
+    {
+        std::unique_lock<std::mutex> lock(generationGuard);
+        return generation;
+    }
+
+    //blocks until generation differs from lastGeneration or timeout expires, returns current generation
+    unsigned long long waitFrame(unsigned long long lastGeneration, int timeoutMs) const
+    {
+        std::unique_lock<std::mutex> lock(generationGuard);
+        generationChanged.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                   [&]() { return generation != lastGeneration; });
+        return generation;
+    }
+
+protected:
+    //should be called by implementations after new frame become available
+    void notifyFrame()
+    {
+        {
+            std::unique_lock<std::mutex> lock(generationGuard);
+            ++generation;
+        }
+        generationChanged.notify_all();
+    }
+
+private:
+    mutable std::mutex generationGuard;
+    mutable std::condition_variable generationChanged;
+    unsigned long long generation;
 };
 
 #endif // FRAMESOURCE_H
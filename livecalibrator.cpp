@@ -0,0 +1,272 @@
+#include "livecalibrator.h"
+#include "pipelinetrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+
+namespace
+{
+    //mean corner displacement relative to image width, needed to accept a view
+    const double minViewDistance = 0.05;
+
+    double getMeanDistance(const std::vector<cv::Point2f>& a, const std::vector<cv::Point2f>& b)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            const cv::Point2f d = a[i] - b[i];
+            sum += std::sqrt(d.x * d.x + d.y * d.y);
+        }
+        return a.empty() ? 0 : sum / a.size();
+    }
+}
+
+LiveCalibrator::Status::Status()
+    : checkedFrames(0)
+    , views(0)
+    , boardVisible(false)
+    , rms(-1)
+    , coverage(0)
+{
+}
+
+LiveCalibrator::LiveCalibrator()
+    : source(nullptr)
+    , checkIntervalMs(500)
+    , stopCalibration(false)
+{
+}
+
+LiveCalibrator::~LiveCalibrator()
+{
+    stop();
+}
+
+bool LiveCalibrator::start(FrameSource &source, int squareSize, int wcount, int hcount)
+{
+    stop();
+
+    if (wcount <= 0 || hcount <= 0)
+    {
+        return false;
+    }
+
+    this->source = &source;
+    boardSize = cv::Size(wcount, hcount);
+    boardPoints.clear();
+    for (int i = 0; i < boardSize.height; i++)
+    {
+        for (int j = 0; j < boardSize.width; j++)
+        {
+            boardPoints.push_back(cv::Point3f(float(j*squareSize), float(i*squareSize), 0));
+        }
+    }
+    resetViews(cv::Size());
+    {
+        std::unique_lock<std::mutex> lock(statusGuard);
+        status.checkedFrames = 0;
+        status.boardVisible = false;
+    }
+
+    stopCalibration = false;
+    thread = std::thread(&LiveCalibrator::calibrating, this);
+    return true;
+}
+
+void LiveCalibrator::stop()
+{
+    stopCalibration = true;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+}
+
+bool LiveCalibrator::isRunning() const
+{
+    return thread.joinable() && !stopCalibration;
+}
+
+void LiveCalibrator::setCheckInterval(int ms)
+{
+    checkIntervalMs = ms;
+}
+
+LiveCalibrator::Status LiveCalibrator::getStatus() const
+{
+    std::unique_lock<std::mutex> lock(statusGuard);
+    Status copy = status;
+    copy.coverageGrid = status.coverageGrid.clone();
+    return copy;
+}
+
+bool LiveCalibrator::save(const std::string &fileName) const
+{
+    std::unique_lock<std::mutex> lock(statusGuard);
+    if (status.cameraMatrix.empty())
+    {
+        return false;
+    }
+    try
+    {
+        cv::FileStorage storage(fileName, cv::FileStorage::WRITE);
+        storage << "cameraMatrix" << status.cameraMatrix;
+        storage << "distCoeffs" << status.distCoeffs;
+        storage << "rms" << status.rms;
+        storage << "imagesCount" << static_cast<int>(status.views);
+        return storage.isOpened();
+    }
+    catch(std::exception& err)
+    {
+        std::cerr << err.what() << std::endl;
+        return false;
+    }
+}
+
+void LiveCalibrator::calibrating()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    PipelineTrace::setThreadName("calibrator");
+    unsigned long long generation = 0;
+    Clock::time_point nextCheck = Clock::now();
+    while (!stopCalibration)
+    {
+        //reduced rate leaves camera and view threads alone
+        if (Clock::now() < nextCheck)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        auto current = source->waitFrame(generation, 50);
+        if (current == generation)
+        {
+            continue;
+        }
+        generation = current;
+        nextCheck = Clock::now() + std::chrono::milliseconds(checkIntervalMs);
+
+        FramePtr frame;
+        FrameInfo info;
+        source->getFrame(frame, info);
+        if (!frame || frame->empty())
+        {
+            continue;
+        }
+
+        ScopedTraceEvent frameEvent("calibration frame", info);
+        try
+        {
+            cv::Mat gray;
+            if (frame->channels() == 3)
+            {
+                cv::cvtColor(*frame, gray, cv::COLOR_BGR2GRAY);
+            }
+            else
+            {
+                gray = *frame;
+            }
+
+            if (gray.size() != imageSize)
+            {
+                resetViews(gray.size());
+            }
+
+            std::vector<cv::Point2f> corners;
+            const bool found = camera::utils::findChessboard(gray, boardSize, camera::utils::DETECTION_DOWNSCALED, corners);
+            {
+                std::unique_lock<std::mutex> lock(statusGuard);
+                ++status.checkedFrames;
+                status.boardVisible = found;
+            }
+
+            if (found && views.size() < maxViews && isNewView(corners))
+            {
+                views.push_back(corners);
+                addCoverage(corners);
+                if (views.size() >= minViews)
+                {
+                    estimate();
+                }
+            }
+        }
+        catch(std::exception& err)
+        {
+            std::cerr << err.what() << std::endl;
+        }
+    }
+}
+
+void LiveCalibrator::resetViews(const cv::Size &size)
+{
+    imageSize = size;
+    views.clear();
+    cameraMatrix = cv::Mat();
+    distCoeffs = cv::Mat();
+
+    std::unique_lock<std::mutex> lock(statusGuard);
+    status.views = 0;
+    status.rms = -1;
+    status.coverage = 0;
+    status.coverageGrid = cv::Mat::zeros(coverageCells, coverageCells, CV_32S);
+    status.cameraMatrix = cv::Mat();
+    status.distCoeffs = cv::Mat();
+    status.imageSize = size;
+}
+
+bool LiveCalibrator::isNewView(const std::vector<cv::Point2f> &corners) const
+{
+    const double minDistance = minViewDistance * imageSize.width;
+    for (const auto& view : views)
+    {
+        if (getMeanDistance(view, corners) < minDistance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void LiveCalibrator::addCoverage(const std::vector<cv::Point2f> &corners)
+{
+    std::unique_lock<std::mutex> lock(statusGuard);
+    for (const auto& corner : corners)
+    {
+        const int x = std::min(std::max(static_cast<int>(corner.x * coverageCells / imageSize.width), 0), coverageCells - 1);
+        const int y = std::min(std::max(static_cast<int>(corner.y * coverageCells / imageSize.height), 0), coverageCells - 1);
+        ++status.coverageGrid.at<int>(y, x);
+    }
+    status.coverage = static_cast<double>(cv::countNonZero(status.coverageGrid)) / (coverageCells * coverageCells);
+    status.views = views.size();
+}
+
+void LiveCalibrator::estimate()
+{
+    //previous estimate is the starting point, so each new view needs only a few iterations
+    int flags = CV_CALIB_FIX_K4 | CV_CALIB_FIX_K5;
+    cv::Mat newCameraMatrix = cameraMatrix.empty() ? cv::Mat::eye(3, 3, CV_64F) : cameraMatrix.clone();
+    cv::Mat newDistCoeffs = distCoeffs.empty() ? cv::Mat::zeros(8, 1, CV_64F) : distCoeffs.clone();
+    if (!cameraMatrix.empty())
+    {
+        flags |= cv::CALIB_USE_INTRINSIC_GUESS;
+    }
+
+    const std::vector<std::vector<cv::Point3f>> objectPoints(views.size(), boardPoints);
+    std::vector<cv::Mat> rvecs, tvecs;
+    const double rms = cv::calibrateCamera(objectPoints, views, imageSize, newCameraMatrix, newDistCoeffs,
+                                           rvecs, tvecs, flags);
+
+    if (cv::checkRange(newCameraMatrix) && cv::checkRange(newDistCoeffs))
+    {
+        cameraMatrix = newCameraMatrix;
+        distCoeffs = newDistCoeffs;
+
+        std::unique_lock<std::mutex> lock(statusGuard);
+        status.rms = rms;
+        status.cameraMatrix = cameraMatrix.clone();
+        status.distCoeffs = distCoeffs.clone();
+    }
+}
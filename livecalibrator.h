@@ -0,0 +1,100 @@
+#ifndef LIVECALIBRATOR_H
+#define LIVECALIBRATOR_H
+
+#include "framesource.h"
+#include "camerautils.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//calibrates one camera from live frames, frames are checked for chessboard on own thread at reduced rate,
+//accepted views are kept in memory and intrinsics are re-estimated after each new view
+class LiveCalibrator
+{
+public:
+    struct Status
+    {
+        Status();
+
+        unsigned long long checkedFrames;
+        size_t views;
+        bool boardVisible;      //chessboard found in last checked frame
+        double rms;             //reprojection error of current estimate, negative before first one
+        double coverage;        //part of coverage grid cells with accepted corners
+        cv::Mat coverageGrid;   //CV_32S, accepted corners in each cell
+        cv::Mat cameraMatrix;
+        cv::Mat distCoeffs;
+        cv::Size imageSize;
+    };
+
+    //views needed for first estimate
+    static const size_t minViews = 4;
+
+    //views are not accepted after this count, each estimate uses all of them
+    static const size_t maxViews = 40;
+
+    //cells of coverage grid along each image side
+    static const int coverageCells = 4;
+
+    LiveCalibrator();
+
+    ~LiveCalibrator();
+
+    LiveCalibrator(const LiveCalibrator&) = delete;
+
+    LiveCalibrator& operator=(const LiveCalibrator&) = delete;
+
+    //previous views are dropped, source should provide frames of the camera before undistortion or rectification
+    bool start(FrameSource& source, int squareSize, int wcount, int hcount);
+
+    void stop();
+
+    bool isRunning() const;
+
+    //minimal interval between checked frames
+    void setCheckInterval(int ms);
+
+    Status getStatus() const;
+
+    //same format as camera::utils::calibrate
+    bool save(const std::string& fileName) const;
+
+private:
+
+    void calibrating();
+
+    //views of different frame sizes can not be combined, so they are dropped when size changes
+    void resetViews(const cv::Size& size);
+
+    //view should differ from all accepted ones, otherwise still board adds nothing
+    bool isNewView(const std::vector<cv::Point2f>& corners) const;
+
+    void addCoverage(const std::vector<cv::Point2f>& corners);
+
+    void estimate();
+
+private:
+
+    FrameSource* source;
+    cv::Size boardSize;
+    std::vector<cv::Point3f> boardPoints;
+    std::atomic<int> checkIntervalMs;
+
+    //used only by calibrating thread
+    cv::Size imageSize;
+    std::vector<std::vector<cv::Point2f>> views;
+    cv::Mat cameraMatrix;
+    cv::Mat distCoeffs;
+
+    Status status;
+    mutable std::mutex statusGuard;
+
+    std::thread thread;
+    std::atomic<bool> stopCalibration;
+};
+
+#endif // LIVECALIBRATOR_H
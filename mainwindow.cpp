@@ -8,6 +8,9 @@
 #include <QtWidgets>
 
 #include <functional>
+#include <future>
+#include <atomic>
+#include <iostream>
 
 MainWindow::MainWindow(QWidget *parent) :
     QMainWindow(parent),
@@ -15,6 +18,10 @@ MainWindow::MainWindow(QWidget *parent) :
     scaleFactor(1.0),
     currentX(0),
     currentY(0),
+    roiSelecting(false),
+    calibrationDone(0),
+    calibrationTotal(0),
+    calibrationProgress(nullptr),
     colorViewType(COLOR_RGB),
     currentCamera{-1,-1},
     workingDir(QDir::currentPath()),
@@ -24,9 +31,24 @@ MainWindow::MainWindow(QWidget *parent) :
 
     scaleStatusLabel = new QLabel(this);
     coordsStatusLabel = new QLabel(this);   
+    pipelineStatusLabel = new QLabel(this);
+    stageStatusLabel = new QLabel(this);
+    liveCalibrationStatusLabel = new QLabel(this);
 
     ui->statusbar->addWidget(scaleStatusLabel);
     ui->statusbar->addWidget(coordsStatusLabel);
+    ui->statusbar->addWidget(pipelineStatusLabel);
+    ui->statusbar->addWidget(stageStatusLabel);
+    ui->statusbar->addWidget(liveCalibrationStatusLabel);
+    stageStatusLabel->setVisible(false);
+    liveCalibrationStatusLabel->setVisible(false);
+
+    pipelineStatusTimer = new QTimer(this);
+    connect(pipelineStatusTimer, SIGNAL(timeout()), this, SLOT(updatePipelineStatus()));
+    pipelineStatusTimer->start(1000);
+
+    calibrationTimer = new QTimer(this);
+    connect(calibrationTimer, SIGNAL(timeout()), this, SLOT(updateCalibrationProgress()));
 
     ui->imageLabel1->installEventFilter(this);
     ui->imageLabel1->setMouseTracking(true);
@@ -38,16 +60,21 @@ MainWindow::MainWindow(QWidget *parent) :
     updateActions();
 
     //initialze camera connections
-    camera[0].setFrameCallback(std::bind(&FrameProcessor::setFrame, &frameProcessor[0], std::placeholders::_1));
+    //frames are rectified once and shared by view and depth map
+    camera[0].setFrameCallback(std::bind(&Rectifier::setFrame, &rectifier[0], std::placeholders::_1, std::placeholders::_2));
+    player[0].setFrameCallback(std::bind(&Rectifier::setFrame, &rectifier[0], std::placeholders::_1, std::placeholders::_2));
+    rectifier[0].setFrameCallback(std::bind(&FrameProcessor::setFrame, &frameProcessor[0], std::placeholders::_1, std::placeholders::_2));
     converter[0].setFrameSource(frameProcessor[0]);
     connect(&converter[0], SIGNAL(imageReady(QImage)), this, SLOT(setImage1(QImage)));
 
-    camera[1].setFrameCallback(std::bind(&FrameProcessor::setFrame, &frameProcessor[1], std::placeholders::_1));
+    camera[1].setFrameCallback(std::bind(&Rectifier::setFrame, &rectifier[1], std::placeholders::_1, std::placeholders::_2));
+    player[1].setFrameCallback(std::bind(&Rectifier::setFrame, &rectifier[1], std::placeholders::_1, std::placeholders::_2));
+    rectifier[1].setFrameCallback(std::bind(&FrameProcessor::setFrame, &frameProcessor[1], std::placeholders::_1, std::placeholders::_2));
     converter[1].setFrameSource(frameProcessor[1]);
     connect(&converter[1], SIGNAL(imageReady(QImage)), this, SLOT(setImage2(QImage)));
 
-    depthMapBuilder.setLeftSource(frameProcessor[0]);
-    depthMapBuilder.setRightSource(frameProcessor[1]);
+    depthMapBuilder.setLeftSource(rectifier[0]);
+    depthMapBuilder.setRightSource(rectifier[1]);
     converter[2].setFrameSource(depthMapBuilder);
     connect(&converter[2], SIGNAL(imageReady(QImage)), this, SLOT(setDepthImage(QImage)));
 
@@ -127,16 +154,74 @@ bool MainWindow::eventFilter(QObject *target, QEvent *event)
         {
             currentX = mouseEvent->x();
             currentY = mouseEvent->y();
+            if (roiSelecting && target == ui->imageLabel1)
+            {
+                roiEnd = mouseEvent->pos();
+            }
             updateStatusBar();
             ui->imageLabel1->update();
             ui->imageLabel2->update();
         }
     }
+    else if (target == ui->imageLabel1
+             && (event->type() == QEvent::MouseButtonPress || event->type() == QEvent::MouseButtonRelease))
+    {
+        //left button drag selects depth map region, right click resets it
+        QMouseEvent* mouseEvent = dynamic_cast<QMouseEvent*>(event);
+        if (mouseEvent != nullptr)
+        {
+            if (event->type() == QEvent::MouseButtonPress && mouseEvent->button() == Qt::LeftButton)
+            {
+                roiSelecting = true;
+                roiStart = mouseEvent->pos();
+                roiEnd = roiStart;
+            }
+            else if (event->type() == QEvent::MouseButtonRelease && mouseEvent->button() == Qt::LeftButton && roiSelecting)
+            {
+                roiSelecting = false;
+                roiEnd = mouseEvent->pos();
+                QRect frameRect = labelToFrame().mapRect(QRect(roiStart, roiEnd).normalized());
+                if (frameRect.width() > 1 && frameRect.height() > 1)
+                {
+                    depthMapBuilder.setRoi(cv::Rect(frameRect.x(), frameRect.y(), frameRect.width(), frameRect.height()));
+                }
+            }
+            else if (event->type() == QEvent::MouseButtonPress && mouseEvent->button() == Qt::RightButton)
+            {
+                roiSelecting = false;
+                depthMapBuilder.resetRoi();
+            }
+            ui->imageLabel1->update();
+        }
+    }
     else if ((target == ui->imageLabel1 || target == ui->imageLabel2)
              && event->type() == QEvent::Paint)
     {
         int cam = target == ui->imageLabel1 ? 0 : 1;
-        return imagePaint(dynamic_cast<QLabel*>(target), currentQImage[cam]);
+        bool painted = imagePaint(dynamic_cast<QLabel*>(target), currentQImage[cam]);
+        if (painted && cam == 0)
+        {
+            QRect rect;
+            if (roiSelecting)
+            {
+                rect = QRect(roiStart, roiEnd).normalized();
+            }
+            else
+            {
+                cv::Rect roi = depthMapBuilder.getRoi();
+                if (roi.area() > 0)
+                {
+                    rect = labelToFrame().inverted().mapRect(QRect(roi.x, roi.y, roi.width, roi.height));
+                }
+            }
+            if (!rect.isNull())
+            {
+                QPainter painter(ui->imageLabel1);
+                painter.setPen(QPen(Qt::yellow, 1, roiSelecting ? Qt::DashLine : Qt::SolidLine));
+                painter.drawRect(rect);
+            }
+        }
+        return painted;
     }
     else if (target == ui->depthMapLabel && event->type() == QEvent::Paint)
     {
@@ -145,6 +230,20 @@ bool MainWindow::eventFilter(QObject *target, QEvent *event)
     return QMainWindow::eventFilter(target, event);
 }
 
+QTransform MainWindow::labelToFrame() const
+{
+    //image is scaled by scaleFactor and stretched to label size in fit to window mode
+    double sx = 1.0 / scaleFactor;
+    double sy = 1.0 / scaleFactor;
+    const QImage& img = currentQImage[0];
+    if (ui->scrollArea->widgetResizable() && !img.isNull() && ui->imageLabel1->width() > 0 && ui->imageLabel1->height() > 0)
+    {
+        sx *= static_cast<double>(img.width()) / ui->imageLabel1->width();
+        sy *= static_cast<double>(img.height()) / ui->imageLabel1->height();
+    }
+    return QTransform::fromScale(sx, sy);
+}
+
 void MainWindow::on_actionExit_triggered()
 {
     this->close();
@@ -251,13 +350,19 @@ void MainWindow::updateActions()
         }       
     }
 
-    ui->actionSnapshot->setEnabled(canSnap > 0);
+    //snapshots, recording and camera settings need live cameras
+    const bool replaying = player[0].isReplaying() || player[1].isReplaying();
+
+    ui->actionSnapshot->setEnabled(canSnap > 0 && !replaying);
     ui->actionLoad_Calibration->setEnabled(enable);
-    ui->actionUndistort->setEnabled(enable);
+    //loaded stereo calibration already undistorts while rectifying
+    ui->actionUndistort->setEnabled(enable && !rectifier[0].hasMapping());
     ui->actionNoiseFilter->setEnabled(enable);
+    ui->actionNoiseFilterGpu->setEnabled(enable && FrameProcessor::isGpuNoiseFilterAvailable());
     ui->actionDrawLines->setEnabled(enable);
+    ui->actionRecord->setEnabled(!replaying && (camera[0].getId() >= 0 || camera[1].getId() >= 0));
     ui->actionLoad_Stereo_Calibration->setEnabled(enable);
-    ui->actionCameraParameters->setEnabled(enable);
+    ui->actionCameraParameters->setEnabled(enable && !replaying);
 
     ui->actionDepthMapView->setEnabled(realCamNum > 1);
     ui->actionPC3DView->setEnabled(realCamNum > 1);
@@ -455,24 +560,100 @@ void MainWindow::on_actionCalibrate_triggered()
         calibParamsDlg->exec();
 
         const QString dataFileName = workingDir + utils::getTimestampFileName("/calib-data", "yml");
-        bool ok = camera::utils::calibrate(calibParamsDlg->getSquareSize(),
-                                    calibParamsDlg->getWCount(),
-                                    calibParamsDlg->getHCount(),
-                                    files,
-                                    dataFileName.toStdString());
-        if (ok)
+        const int squareSize = calibParamsDlg->getSquareSize();
+        const int wcount = calibParamsDlg->getWCount();
+        const int hcount = calibParamsDlg->getHCount();
+        //parameters are copied, calibration outlives this handler
+        startCalibration(tr("Calibration"), [=](const camera::utils::ProgressCallback& progress)
         {
-            QMessageBox::information(this, tr("Calibration"), tr("Finished succesfully!"), QMessageBox::Ok);
+            return camera::utils::calibrate(squareSize,
+                                            wcount,
+                                            hcount,
+                                            files,
+                                            dataFileName.toStdString(),
+                                            camera::utils::DETECTION_DOWNSCALED,
+                                            progress);
+        });
+    }
+}
+
+void MainWindow::startCalibration(const QString &title,
+                                  const std::function<bool (const camera::utils::ProgressCallback &)> &calibration)
+{
+    if (calibrationResult.valid())
+    {
+        return;
+    }
+
+    calibrationDone = 0;
+    calibrationTotal = 0;
+    calibrationResult = std::async(std::launch::async, [this, calibration]() -> bool
+    {
+        try
+        {
+            return calibration([this](size_t count, size_t all)
+            {
+                calibrationTotal = all;
+                calibrationDone = count;
+            });
         }
-        else
+        catch(std::exception& err)
+        {
+            std::cerr << err.what() << std::endl;
+            return false;
+        }
+    });
+
+    calibrationTitle = title;
+    calibrationProgress = new QProgressDialog(tr("Detecting chessboards..."), QString(), 0, 0, this);
+    calibrationProgress->setWindowTitle(title);
+    calibrationProgress->setWindowModality(Qt::WindowModal);
+    calibrationProgress->setMinimumDuration(0);
+    calibrationProgress->show();
+    calibrationTimer->start(50);
+}
+
+void MainWindow::updateCalibrationProgress()
+{
+    if (calibrationResult.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+    {
+        const size_t all = calibrationTotal;
+        const size_t count = calibrationDone;
+        if (all > 0 && count < all)
+        {
+            calibrationProgress->setMaximum(static_cast<int>(all));
+            calibrationProgress->setValue(static_cast<int>(count));
+        }
+        else if (all > 0 && calibrationProgress->maximum() != 0)
         {
-            QMessageBox::warning(this, tr("Calibration"), tr("Failed!"));
+            calibrationProgress->setLabelText(tr("Calibrating..."));
+            calibrationProgress->setRange(0, 0);
         }
+        return;
+    }
+
+    calibrationTimer->stop();
+    calibrationProgress->close();
+    calibrationProgress->deleteLater();
+    calibrationProgress = nullptr;
+
+    if (calibrationResult.get())
+    {
+        QMessageBox::information(this, calibrationTitle, tr("Finished succesfully!"), QMessageBox::Ok);
+    }
+    else
+    {
+        QMessageBox::warning(this, calibrationTitle, tr("Failed!"));
     }
 }
 
 void MainWindow::on_actionUndistort_triggered()
 {    
+    if (rectifier[0].hasMapping())
+    {
+        ui->actionUndistort->setChecked(false);
+        return;
+    }
     frameProcessor[0].setApplyUndistort(!frameProcessor[0].isUndistortApplied());
     frameProcessor[1].setApplyUndistort(!frameProcessor[1].isUndistortApplied());
     ui->actionUndistort->setChecked(frameProcessor[0].isUndistortApplied() &&
@@ -533,6 +714,8 @@ void MainWindow::on_actionCameraSetup_triggered()
         frameProcessor[1].stopProcessing();
         camera[0].stopCapture();
         camera[1].stopCapture();
+        player[0].stopReplay();
+        player[1].stopReplay();
 
         //start
         camera[0].startCapture(camSetupDlg->getLeftDeviceId(), camSetupDlg->getDeviceFormat());
@@ -540,6 +723,8 @@ void MainWindow::on_actionCameraSetup_triggered()
 
         camera[1].startCapture(camSetupDlg->getRightDeviceId(), camSetupDlg->getDeviceFormat());
         frameProcessor[1].startProcessing();       
+
+        updateActions();
     }
 }
 
@@ -623,20 +808,21 @@ void MainWindow::on_actionStereo_Calibrate_triggered()
         calibParamsDlg->exec();
 
         const QString dataFileName = workingDir + utils::getTimestampFileName("/stereo-calib-data", "yml");
-        bool ok = camera::utils::stereoCalibrate(calibParamsDlg->getSquareSize(),
-                                    calibParamsDlg->getWCount(),
-                                    calibParamsDlg->getHCount(),
-                                    filesLeft,
-                                    filesRight,
-                                    dataFileName.toStdString());
-        if (ok)
-        {
-            QMessageBox::information(this, tr("Stereo Calibration"), tr("Finished succesfully!"), QMessageBox::Ok);
-        }
-        else
+        const int squareSize = calibParamsDlg->getSquareSize();
+        const int wcount = calibParamsDlg->getWCount();
+        const int hcount = calibParamsDlg->getHCount();
+        //parameters are copied, calibration outlives this handler
+        startCalibration(tr("Stereo Calibration"), [=](const camera::utils::ProgressCallback& progress)
         {
-            QMessageBox::warning(this, tr("Stereo Calibration"), tr("Failed!"));
-        }
+            return camera::utils::stereoCalibrate(squareSize,
+                                                  wcount,
+                                                  hcount,
+                                                  filesLeft,
+                                                  filesRight,
+                                                  dataFileName.toStdString(),
+                                                  camera::utils::DETECTION_DOWNSCALED,
+                                                  progress);
+        });
     }
 }
 
@@ -647,15 +833,21 @@ void MainWindow::on_actionLoad_Stereo_Calibration_triggered()
     {
         if (depthMapBuilder.loadCalibrationParams(fileName.toStdString()))
         {
-            cv::Size imgSize(this->currentSize.width(), this->currentSize.height());
-            cv::Mat mapx, mapy;
-            cv::Rect roi;
+            //mappings are built for camera frames, displayed image can be scaled or already rectified
+            cv::Size imgSize = rectifier[0].getInputSize();
+            if (imgSize.area() == 0)
+            {
+                imgSize = cv::Size(this->currentSize.width(), this->currentSize.height());
+            }
 
-            depthMapBuilder.getLeftMapping(imgSize, mapx, mapy, roi);
-            frameProcessor[0].setUndistortMappings(mapx, mapy, roi);
+            rectifier[0].setMapping(depthMapBuilder.getLeftMapping(imgSize));
+            rectifier[1].setMapping(depthMapBuilder.getRightMapping(imgSize));
 
-            depthMapBuilder.getRightMapping(imgSize, mapx, mapy, roi);
-            frameProcessor[1].setUndistortMappings(mapx, mapy, roi);
+            //frames are undistorted by rectification, second undistort would distort them again
+            frameProcessor[0].setApplyUndistort(false);
+            frameProcessor[1].setApplyUndistort(false);
+            ui->actionUndistort->setChecked(false);
+            updateActions();
 
             QMessageBox::information(this, tr("Stereo Calibration"), tr("Loaded succesfully!"), QMessageBox::Ok);
         }
@@ -705,25 +897,24 @@ void MainWindow::on_actionPC3DView_triggered()
         ui->viewStackedWidget->setCurrentIndex(2);
 
 
-        std::vector<cv::Vec3f> points;
-        std::vector<cv::Vec3b> colors;
-        depthMapBuilder.getPoints(points, colors);
+        auto points = depthMapBuilder.getPoints();
+        const size_t count = points ? points->count : 0;
 
-        cloud->points.resize (points.size());
+        cloud->points.resize (count);
 
         // Fill the cloud with points
-        for (size_t i = 0; i < cloud->points.size (); ++i)
+        for (size_t i = 0; i < count; ++i)
         {
-            cloud->points[i].x = points[i][0];
-            cloud->points[i].y = points[i][1];
-            cloud->points[i].z = points[i][2];
+            cloud->points[i].x = points->x[i];
+            cloud->points[i].y = points->y[i];
+            cloud->points[i].z = points->z[i];
 
-            cloud->points[i].r = colors[i][0];
-            cloud->points[i].g = colors[i][1];
-            cloud->points[i].b = colors[i][2];
+            cloud->points[i].r = points->red[i];
+            cloud->points[i].g = points->green[i];
+            cloud->points[i].b = points->blue[i];
         }
 
-        cloud->width = points.size();
+        cloud->width = count;
         cloud->height = 1;
 
         if (!viewer->updatePointCloud(cloud, "cloud"))
@@ -751,6 +942,14 @@ void MainWindow::on_actionNoiseFilter_triggered()
                                     frameProcessor[1].isNoiseFilterApplied());
 }
 
+void MainWindow::on_actionNoiseFilterGpu_triggered()
+{
+    frameProcessor[0].setNoiseFilterOnGpu(!frameProcessor[0].isNoiseFilterOnGpu());
+    frameProcessor[1].setNoiseFilterOnGpu(!frameProcessor[1].isNoiseFilterOnGpu());
+    ui->actionNoiseFilterGpu->setChecked(frameProcessor[0].isNoiseFilterOnGpu() &&
+                                         frameProcessor[1].isNoiseFilterOnGpu());
+}
+
 void MainWindow::on_actionDrawLines_triggered()
 {
     frameProcessor[0].setDrawLines(!frameProcessor[0].isDrawLines());
@@ -758,3 +957,274 @@ void MainWindow::on_actionDrawLines_triggered()
     ui->actionDrawLines->setChecked(frameProcessor[0].isDrawLines() &&
                                     frameProcessor[1].isDrawLines());
 }
+
+void MainWindow::on_actionRecord_triggered()
+{
+    if (camera[0].isRecording() || camera[1].isRecording())
+    {
+        camera[0].stopRecording();
+        camera[1].stopRecording();
+    }
+    else
+    {
+        QDir wdir(workingDir);
+        if (!wdir.exists())
+        {
+            QDir().mkdir(workingDir);
+        }
+
+        //both files get the same timestamp, so replay finds the pair
+        const QString filename = workingDir + utils::getTimestampFileName("/rec_%1", "screc");
+        for (int i = 0; i < camNumber; ++i)
+        {
+            camera[i].startRecording(filename.arg(i).toStdString());
+        }
+    }
+    ui->actionRecord->setChecked(camera[0].isRecording() || camera[1].isRecording());
+}
+
+void MainWindow::on_actionReplay_triggered()
+{
+    const QString leftName = QFileDialog::getOpenFileName(this,
+                                                          tr("Replay recording"),
+                                                          workingDir,
+                                                          tr("Recordings (rec_0-*.screc)"));
+    if (leftName.isEmpty())
+    {
+        return;
+    }
+    QFileInfo leftInfo(leftName);
+    const QString rightName = leftInfo.dir().filePath(leftInfo.fileName().replace("rec_0-", "rec_1-"));
+
+    depthMapBuilder.stopProcessing();
+    frameProcessor[0].stopProcessing();
+    frameProcessor[1].stopProcessing();
+    camera[0].stopCapture();
+    camera[1].stopCapture();
+    ui->actionRecord->setChecked(false);
+
+    bool ok = true;
+    const QString names[camNumber] = {leftName, rightName};
+    //both recordings advance by the longer span on each pass, otherwise pairs drift apart with every loop
+    unsigned long long passDuration = 0;
+    for (int i = 0; i < camNumber; ++i)
+    {
+        passDuration = std::max(passDuration, StreamPlayer::getPassDuration(names[i].toStdString()));
+    }
+    for (int i = 0; i < camNumber; ++i)
+    {
+        player[i].setLoop(true);
+        player[i].setPassDuration(passDuration);
+        if (!player[i].startReplay(names[i].toStdString()))
+        {
+            ok = false;
+        }
+        frameProcessor[i].startProcessing();
+    }
+
+    //depth view does not restart processing while it stays current
+    if (ui->viewStackedWidget->currentIndex() == 1)
+    {
+        depthMapBuilder.startProcessing();
+    }
+    updateActions();
+
+    if (!ok)
+    {
+        QMessageBox::warning(this, tr("Replay"), tr("Failed to open %1 or %2").arg(leftName).arg(rightName));
+    }
+}
+
+void MainWindow::updatePipelineStatus()
+{
+    QString status = QString("Dropped : %1, %2 ").arg(camera[0].getDroppedFrames()).arg(camera[1].getDroppedFrames());
+
+    if (ui->viewStackedWidget->currentIndex() == 1)
+    {
+        auto stat = depthMapBuilder.getSyncStatistics();
+        status += QString("Pairs : %1 Skew : %2 / %3 ms Rejected : %4, %5 ")
+                  .arg(stat.pairs)
+                  .arg(stat.meanSkew, 0, 'f', 1)
+                  .arg(stat.maxSkew, 0, 'f', 1)
+                  .arg(stat.rejectedLeft)
+                  .arg(stat.rejectedRight);
+
+        status += QString("Depth fps : %1 Match : %2 ms ")
+                  .arg(depthMapBuilder.getFrameRate(), 0, 'f', 1)
+                  .arg(depthMapBuilder.getMatchingTime(), 0, 'f', 0);
+        if (depthMapBuilder.isQualityMode())
+        {
+            status += QString("WLS : +%1 ms ").arg(depthMapBuilder.getFilterLatency(), 0, 'f', 0);
+        }
+        if (depthMapBuilder.isTemporalReuse())
+        {
+            auto reuse = depthMapBuilder.getReuseStatistics();
+            status += QString("Reused : %1% (mean %2%, full %3/%4) ")
+                      .arg(reuse.lastReused * 100, 0, 'f', 0)
+                      .arg(reuse.meanReused * 100, 0, 'f', 0)
+                      .arg(reuse.keyFrames)
+                      .arg(reuse.frames);
+        }
+    }
+
+    status += QString("CPU% : camera %1, %2 processor %3, %4 depth %5 view %6, %7, %8 ")
+              .arg(camera[0].getCpuUsage(), 0, 'f', 0)
+              .arg(camera[1].getCpuUsage(), 0, 'f', 0)
+              .arg(frameProcessor[0].getCpuUsage(), 0, 'f', 0)
+              .arg(frameProcessor[1].getCpuUsage(), 0, 'f', 0)
+              .arg(depthMapBuilder.getCpuUsage(), 0, 'f', 0)
+              .arg(converter[0].getCpuUsage(), 0, 'f', 0)
+              .arg(converter[1].getCpuUsage(), 0, 'f', 0)
+              .arg(converter[2].getCpuUsage(), 0, 'f', 0);
+
+    auto poolStatus = [](const FramePool::Statistics& stat)
+    {
+        return QString("%1/%2").arg(stat.highWater).arg(stat.exhausted);
+    };
+    status += QString("Pool peak/miss : camera %1, %2 rectifier %3, %4 processor %5, %6 depth %7 ")
+              .arg(poolStatus(camera[0].getPoolStatistics()))
+              .arg(poolStatus(camera[1].getPoolStatistics()))
+              .arg(poolStatus(rectifier[0].getPoolStatistics()))
+              .arg(poolStatus(rectifier[1].getPoolStatistics()))
+              .arg(poolStatus(frameProcessor[0].getPoolStatistics()))
+              .arg(poolStatus(frameProcessor[1].getPoolStatistics()))
+              .arg(poolStatus(depthMapBuilder.getPoolStatistics()));
+
+    pipelineStatusLabel->setText(status);
+
+    //median and 95th percentile of each stage over the last second, ms
+    auto snapshot = StageStatistics::getSnapshot();
+    if (stageStatusLabel->isVisible())
+    {
+        auto interval = StageStatistics::difference(snapshot, stageSnapshot);
+        QString stages("Stages p50/p95 ms : ");
+        for (int i = 0; i < StageStatistics::STAGES_COUNT; ++i)
+        {
+            const auto& histogram = interval.stages[i];
+            if (histogram.count > 0)
+            {
+                stages += QString("%1 %2/%3 ")
+                          .arg(StageStatistics::getStageName(static_cast<StageStatistics::Stage>(i)))
+                          .arg(histogram.percentile(50) / 1000, 0, 'f', 1)
+                          .arg(histogram.percentile(95) / 1000, 0, 'f', 1);
+            }
+        }
+        stageStatusLabel->setText(stages);
+    }
+    stageSnapshot = snapshot;
+
+    if (liveCalibrationStatusLabel->isVisible())
+    {
+        auto calib = liveCalibrator.getStatus();
+        //one character per coverage cell, rows separated by bars
+        QString grid;
+        for (int y = 0; y < calib.coverageGrid.rows; ++y)
+        {
+            grid += y == 0 ? "" : "|";
+            for (int x = 0; x < calib.coverageGrid.cols; ++x)
+            {
+                grid += calib.coverageGrid.at<int>(y, x) > 0 ? "#" : ".";
+            }
+        }
+        liveCalibrationStatusLabel->setText(QString("Calibration : board %1 views %2/%3 coverage %4% [%5] RMS %6 ")
+                                            .arg(calib.boardVisible ? tr("yes") : tr("no"))
+                                            .arg(calib.views)
+                                            .arg(LiveCalibrator::maxViews)
+                                            .arg(calib.coverage * 100, 0, 'f', 0)
+                                            .arg(grid)
+                                            .arg(calib.rms < 0 ? QString("-") : QString::number(calib.rms, 'f', 3)));
+    }
+}
+
+void MainWindow::on_actionStageStatistics_triggered()
+{
+    stageStatusLabel->setVisible(ui->actionStageStatistics->isChecked());
+}
+
+void MainWindow::on_actionTracePipeline_triggered()
+{
+    //new trace starts from empty ring buffers
+    if (ui->actionTracePipeline->isChecked())
+    {
+        PipelineTrace::clear();
+    }
+    PipelineTrace::setEnabled(ui->actionTracePipeline->isChecked());
+}
+
+void MainWindow::on_actionSaveTrace_triggered()
+{
+    QDir wdir(workingDir);
+    if (!wdir.exists())
+    {
+        QDir().mkdir(workingDir);
+    }
+
+    const QString filename = workingDir + utils::getTimestampFileName("/trace", "json");
+    if (!PipelineTrace::writeChromeTrace(filename.toStdString()))
+    {
+        QMessageBox::warning(this, tr("Pipeline trace"), tr("Failed to write %1").arg(filename));
+    }
+}
+
+void MainWindow::on_actionLiveCalibration_triggered()
+{
+    if (!ui->actionLiveCalibration->isChecked())
+    {
+        liveCalibrator.stop();
+        liveCalibrationStatusLabel->setVisible(false);
+        return;
+    }
+
+    //views should be taken from frames as camera sees them
+    if (rectifier[0].hasMapping())
+    {
+        QMessageBox::warning(this, tr("Live Calibration"), tr("Frames are rectified by loaded stereo calibration."));
+        ui->actionLiveCalibration->setChecked(false);
+        return;
+    }
+
+    CalibParamsDialog* calibParamsDlg = new CalibParamsDialog(this);
+
+    calibParamsDlg->exec();
+
+    bool ok = liveCalibrator.start(rectifier[0],
+                                   calibParamsDlg->getSquareSize(),
+                                   calibParamsDlg->getWCount(),
+                                   calibParamsDlg->getHCount());
+    ui->actionLiveCalibration->setChecked(ok);
+    liveCalibrationStatusLabel->setVisible(ok);
+}
+
+void MainWindow::on_actionSaveLiveCalibration_triggered()
+{
+    QDir wdir(workingDir);
+    if (!wdir.exists())
+    {
+        QDir().mkdir(workingDir);
+    }
+
+    const QString dataFileName = workingDir + utils::getTimestampFileName("/calib-data", "yml");
+    if (liveCalibrator.save(dataFileName.toStdString()))
+    {
+        QMessageBox::information(this, tr("Live Calibration"), tr("Saved to %1").arg(dataFileName), QMessageBox::Ok);
+    }
+    else
+    {
+        QMessageBox::warning(this, tr("Live Calibration"), tr("Not enough views for calibration yet."));
+    }
+}
+
+void MainWindow::on_actionDumpStageStatistics_triggered()
+{
+    QDir wdir(workingDir);
+    if (!wdir.exists())
+    {
+        QDir().mkdir(workingDir);
+    }
+
+    const QString filename = workingDir + utils::getTimestampFileName("/stages", "json");
+    if (!StageStatistics::dumpJson(filename.toStdString()))
+    {
+        QMessageBox::warning(this, tr("Stage statistics"), tr("Failed to write %1").arg(filename));
+    }
+}
@@ -7,8 +7,15 @@
 #include <qsize.h>
 #include <qsignalmapper.h>
 #include <qthread.h>
+#include <qtimer.h>
+#include <qtransform.h>
 
 #include "camera.h"
+#include "streamplayer.h"
+#include "livecalibrator.h"
+#include "stagestats.h"
+#include "pipelinetrace.h"
+#include "rectifier.h"
 #include "frameprocessor.h"
 #include "depthmapbuilder.h"
 #include "qframeconverter.h"
@@ -25,8 +32,12 @@
 //OpenCV
 #include <opencv2/opencv.hpp>
 
+#include <atomic>
+#include <future>
 #include <memory>
 
+class QProgressDialog;
+
 namespace Ui {
 class MainWindow;
 }
@@ -99,8 +110,30 @@ private slots:
 
     void on_actionNoiseFilter_triggered();
 
+    void on_actionNoiseFilterGpu_triggered();
+
     void on_actionDrawLines_triggered();
 
+    void on_actionRecord_triggered();
+
+    void on_actionReplay_triggered();
+
+    void on_actionStageStatistics_triggered();
+
+    void on_actionDumpStageStatistics_triggered();
+
+    void on_actionTracePipeline_triggered();
+
+    void on_actionSaveTrace_triggered();
+
+    void on_actionLiveCalibration_triggered();
+
+    void on_actionSaveLiveCalibration_triggered();
+
+    void updatePipelineStatus();
+
+    void updateCalibrationProgress();
+
 private:
 
     void setImage(const QImage &img, int imgIndex);
@@ -111,8 +144,16 @@ private:
 
     bool eventFilter(QObject *target, QEvent *event);
 
+    //maps left image label coordinates to rectified frame coordinates
+    QTransform labelToFrame() const;
+
     void updateColorViewType(COLOR_TYPE type);
 
+    //runs calibration in background thread, progress of chessboard detection and result are shown
+    //by updateCalibrationProgress, nothing is started while other calibration runs
+    void startCalibration(const QString& title,
+                          const std::function<bool (const camera::utils::ProgressCallback&)>& calibration);
+
 private:
 
     QImage currentQImage[camNumber]; //for paint event
@@ -124,14 +165,40 @@ private:
     double scaleFactor;
     int currentX;
     int currentY;
+
+    //depth map region of interest dragged on left image, label coordinates
+    bool roiSelecting;
+    QPoint roiStart;
+    QPoint roiEnd;
     
     QLabel* scaleStatusLabel;
     QLabel* coordsStatusLabel;
+    QLabel* pipelineStatusLabel;
+    QLabel* stageStatusLabel;
+    QLabel* liveCalibrationStatusLabel;
+    //previous totals, panel shows the last timer interval
+    StageStatistics::Snapshot stageSnapshot;
+    QTimer* pipelineStatusTimer;
+
+    //counters are written by calibration threads and polled by timer, so they never wait for UI
+    std::atomic<size_t> calibrationDone;
+    std::atomic<size_t> calibrationTotal;
+    QString calibrationTitle;
+    QProgressDialog* calibrationProgress;
+    QTimer* calibrationTimer;
+    //declared after counters, so it waits for calibration before they are destroyed
+    std::future<bool> calibrationResult;
 
     COLOR_TYPE colorViewType;    
 
     FrameProcessor frameProcessor[camNumber];
+    //camera threads call rectifiers, so they should be destroyed after cameras
+    Rectifier rectifier[camNumber];
     Camera camera[camNumber];
+    //replaces cameras, feeds the same rectifiers
+    StreamPlayer player[camNumber];
+    //reads frames of the left rectifier, so it should be destroyed before it
+    LiveCalibrator liveCalibrator;
     int currentCamera[camNumber];
 
     QThread converterThread[camNumber + 1];
@@ -0,0 +1,176 @@
+#include "matcherparams.h"
+#include "sgmstereomatcher.h"
+
+MatcherParams::MatcherParams()
+    : minDisparity(0)
+    , numDisparities(0)
+    , blockSize(0)
+    , P1(0)
+    , P2(0)
+    , disp12MaxDiff(0)
+    , preFilterCap(0)
+    , uniquenessRatio(0)
+    , speckleWindowSize(0)
+    , speckleRange(0)
+    , mode(-1)
+{
+}
+
+MatcherParams::MatcherParams(const cv::StereoSGBM& matcher)
+    : minDisparity(matcher.getMinDisparity())
+    , numDisparities(matcher.getNumDisparities())
+    , blockSize(matcher.getBlockSize())
+    , P1(matcher.getP1())
+    , P2(matcher.getP2())
+    , disp12MaxDiff(matcher.getDisp12MaxDiff())
+    , preFilterCap(matcher.getPreFilterCap())
+    , uniquenessRatio(matcher.getUniquenessRatio())
+    , speckleWindowSize(matcher.getSpeckleWindowSize())
+    , speckleRange(matcher.getSpeckleRange())
+    , mode(matcher.getMode())
+{
+}
+
+bool MatcherParams::operator==(const MatcherParams& other) const
+{
+    return minDisparity == other.minDisparity
+            && numDisparities == other.numDisparities
+            && blockSize == other.blockSize
+            && P1 == other.P1
+            && P2 == other.P2
+            && disp12MaxDiff == other.disp12MaxDiff
+            && preFilterCap == other.preFilterCap
+            && uniquenessRatio == other.uniquenessRatio
+            && speckleWindowSize == other.speckleWindowSize
+            && speckleRange == other.speckleRange
+            && mode == other.mode;
+}
+
+bool MatcherParams::operator!=(const MatcherParams& other) const
+{
+    return !(*this == other);
+}
+
+cv::Ptr<cv::StereoSGBM> MatcherParams::createMatcher() const
+{
+    if (mode == SgmStereoMatcher::MODE_CENSUS)
+    {
+        return SgmStereoMatcher::create(minDisparity, numDisparities, P1, P2,
+                                        disp12MaxDiff, uniquenessRatio,
+                                        speckleWindowSize, speckleRange);
+    }
+    return cv::StereoSGBM::create(minDisparity, numDisparities, blockSize,
+                                  P1, P2, disp12MaxDiff, preFilterCap,
+                                  uniquenessRatio, speckleWindowSize, speckleRange,
+                                  mode);
+}
+
+int WrappedStereoMatcher::getMinDisparity() const
+{
+    return getMatcher()->getMinDisparity();
+}
+
+void WrappedStereoMatcher::setMinDisparity(int minDisparity)
+{
+    getMatcher()->setMinDisparity(minDisparity);
+}
+
+int WrappedStereoMatcher::getNumDisparities() const
+{
+    return getMatcher()->getNumDisparities();
+}
+
+void WrappedStereoMatcher::setNumDisparities(int numDisparities)
+{
+    getMatcher()->setNumDisparities(numDisparities);
+}
+
+int WrappedStereoMatcher::getBlockSize() const
+{
+    return getMatcher()->getBlockSize();
+}
+
+void WrappedStereoMatcher::setBlockSize(int blockSize)
+{
+    getMatcher()->setBlockSize(blockSize);
+}
+
+int WrappedStereoMatcher::getSpeckleWindowSize() const
+{
+    return getMatcher()->getSpeckleWindowSize();
+}
+
+void WrappedStereoMatcher::setSpeckleWindowSize(int speckleWindowSize)
+{
+    getMatcher()->setSpeckleWindowSize(speckleWindowSize);
+}
+
+int WrappedStereoMatcher::getSpeckleRange() const
+{
+    return getMatcher()->getSpeckleRange();
+}
+
+void WrappedStereoMatcher::setSpeckleRange(int speckleRange)
+{
+    getMatcher()->setSpeckleRange(speckleRange);
+}
+
+int WrappedStereoMatcher::getDisp12MaxDiff() const
+{
+    return getMatcher()->getDisp12MaxDiff();
+}
+
+void WrappedStereoMatcher::setDisp12MaxDiff(int disp12MaxDiff)
+{
+    getMatcher()->setDisp12MaxDiff(disp12MaxDiff);
+}
+
+int WrappedStereoMatcher::getPreFilterCap() const
+{
+    return getMatcher()->getPreFilterCap();
+}
+
+void WrappedStereoMatcher::setPreFilterCap(int preFilterCap)
+{
+    getMatcher()->setPreFilterCap(preFilterCap);
+}
+
+int WrappedStereoMatcher::getUniquenessRatio() const
+{
+    return getMatcher()->getUniquenessRatio();
+}
+
+void WrappedStereoMatcher::setUniquenessRatio(int uniquenessRatio)
+{
+    getMatcher()->setUniquenessRatio(uniquenessRatio);
+}
+
+int WrappedStereoMatcher::getP1() const
+{
+    return getMatcher()->getP1();
+}
+
+void WrappedStereoMatcher::setP1(int P1)
+{
+    getMatcher()->setP1(P1);
+}
+
+int WrappedStereoMatcher::getP2() const
+{
+    return getMatcher()->getP2();
+}
+
+void WrappedStereoMatcher::setP2(int P2)
+{
+    getMatcher()->setP2(P2);
+}
+
+int WrappedStereoMatcher::getMode() const
+{
+    return getMatcher()->getMode();
+}
+
+void WrappedStereoMatcher::setMode(int mode)
+{
+    getMatcher()->setMode(mode);
+}
@@ -0,0 +1,72 @@
+#ifndef MATCHERPARAMS_H
+#define MATCHERPARAMS_H
+
+#include <opencv2/opencv.hpp>
+
+//snapshot of StereoSGBM parameters, used to create private copies of configured matcher
+struct MatcherParams
+{
+    MatcherParams();
+
+    explicit MatcherParams(const cv::StereoSGBM& matcher);
+
+    bool operator==(const MatcherParams& other) const;
+    bool operator!=(const MatcherParams& other) const;
+
+    //creates OpenCV or census matcher depending on mode
+    cv::Ptr<cv::StereoSGBM> createMatcher() const;
+
+    int minDisparity;
+    int numDisparities;
+    int blockSize;
+    int P1;
+    int P2;
+    int disp12MaxDiff;
+    int preFilterCap;
+    int uniquenessRatio;
+    int speckleWindowSize;
+    int speckleRange;
+    int mode;
+};
+
+//base of matchers which wrap configured StereoSGBM, parameters are read from and written to wrapped matcher
+class WrappedStereoMatcher : public cv::StereoSGBM
+{
+public:
+    virtual cv::Ptr<cv::StereoSGBM> getMatcher() const = 0;
+
+    int getMinDisparity() const override;
+    void setMinDisparity(int minDisparity) override;
+
+    int getNumDisparities() const override;
+    void setNumDisparities(int numDisparities) override;
+
+    int getBlockSize() const override;
+    void setBlockSize(int blockSize) override;
+
+    int getSpeckleWindowSize() const override;
+    void setSpeckleWindowSize(int speckleWindowSize) override;
+
+    int getSpeckleRange() const override;
+    void setSpeckleRange(int speckleRange) override;
+
+    int getDisp12MaxDiff() const override;
+    void setDisp12MaxDiff(int disp12MaxDiff) override;
+
+    int getPreFilterCap() const override;
+    void setPreFilterCap(int preFilterCap) override;
+
+    int getUniquenessRatio() const override;
+    void setUniquenessRatio(int uniquenessRatio) override;
+
+    int getP1() const override;
+    void setP1(int P1) override;
+
+    int getP2() const override;
+    void setP2(int P2) override;
+
+    int getMode() const override;
+    void setMode(int mode) override;
+};
+
+#endif // MATCHERPARAMS_H
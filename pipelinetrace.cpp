@@ -0,0 +1,233 @@
+#include "pipelinetrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+
+struct TraceEvent
+{
+    const char* name;
+    PipelineTrace::Clock::time_point begin;
+    PipelineTrace::Clock::time_point end;
+    FrameInfo frame;
+};
+
+//guard is taken by owner thread on each event and by writer of trace file, so it is almost never contended
+struct ThreadTrace
+{
+    ThreadTrace(int id)
+        : id(id)
+        , next(0)
+        , wrapped(false)
+    {
+    }
+
+    std::mutex guard;
+    int id;
+    std::string name;
+    std::vector<TraceEvent> events;
+    size_t next;
+    bool wrapped;
+    FrameInfo frame;
+};
+
+struct Registry
+{
+    std::mutex guard;
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    std::atomic<bool> enabled{false};
+    PipelineTrace::Clock::time_point epoch = PipelineTrace::Clock::now();
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+ThreadTrace& threadTrace()
+{
+    thread_local std::shared_ptr<ThreadTrace> local;
+    if (!local)
+    {
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.guard);
+        local = std::make_shared<ThreadTrace>(static_cast<int>(r.threads.size()) + 1);
+        r.threads.push_back(local);
+    }
+    return *local;
+}
+
+long long toUs(PipelineTrace::Clock::time_point time, PipelineTrace::Clock::time_point epoch)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(time - epoch).count();
+}
+
+void writeString(std::ostream& out, const std::string& value)
+{
+    out << '"';
+    for (char c : value)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out << '\\';
+        }
+        out << c;
+    }
+    out << '"';
+}
+
+}
+
+void PipelineTrace::setEnabled(bool enabled)
+{
+    registry().enabled = enabled;
+}
+
+bool PipelineTrace::isEnabled()
+{
+    return registry().enabled;
+}
+
+void PipelineTrace::setThreadName(const std::string &name)
+{
+    ThreadTrace& trace = threadTrace();
+    std::unique_lock<std::mutex> lock(trace.guard);
+    trace.name = name;
+}
+
+void PipelineTrace::setCurrentFrame(const FrameInfo &info)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    ThreadTrace& trace = threadTrace();
+    std::unique_lock<std::mutex> lock(trace.guard);
+    trace.frame = info;
+}
+
+void PipelineTrace::record(const char *name, Clock::time_point begin, Clock::time_point end)
+{
+    if (!isEnabled())
+    {
+        return;
+    }
+    ThreadTrace& trace = threadTrace();
+    std::unique_lock<std::mutex> lock(trace.guard);
+    //ring is allocated only when thread is traced
+    if (trace.events.empty())
+    {
+        trace.events.resize(ringCapacity);
+    }
+    TraceEvent& event = trace.events[trace.next];
+    event.name = name;
+    event.begin = begin;
+    event.end = end;
+    event.frame = trace.frame;
+    if (++trace.next == trace.events.size())
+    {
+        trace.next = 0;
+        trace.wrapped = true;
+    }
+}
+
+bool PipelineTrace::writeChromeTrace(const std::string &fileName)
+{
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    Clock::time_point epoch;
+    {
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.guard);
+        threads = r.threads;
+        epoch = r.epoch;
+    }
+
+    std::ofstream out(fileName);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    bool first = true;
+    for (const auto& thread : threads)
+    {
+        //events are copied, so traced threads wait only for the copy
+        std::vector<TraceEvent> events;
+        std::string name;
+        {
+            std::unique_lock<std::mutex> lock(thread->guard);
+            name = thread->name;
+            if (thread->wrapped)
+            {
+                events.insert(events.end(), thread->events.begin() + thread->next, thread->events.end());
+            }
+            events.insert(events.end(), thread->events.begin(), thread->events.begin() + thread->next);
+        }
+        if (events.empty())
+        {
+            continue;
+        }
+
+        out << (first ? "" : ",\n")
+            << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << thread->id
+            << ", \"args\": {\"name\": ";
+        writeString(out, name.empty() ? "thread " + std::to_string(thread->id) : name);
+        out << "}}";
+        first = false;
+
+        for (const auto& event : events)
+        {
+            out << ",\n{\"name\": ";
+            writeString(out, event.name);
+            out << ", \"ph\": \"X\", \"pid\": 1, \"tid\": " << thread->id
+                << ", \"ts\": " << toUs(event.begin, epoch)
+                << ", \"dur\": " << std::max(0LL, toUs(event.end, epoch) - toUs(event.begin, epoch))
+                << ", \"args\": {\"frame\": " << event.frame.timestamp
+                << ", \"sequence\": " << event.frame.sequence << "}}";
+        }
+    }
+    out << "\n]}\n";
+    return static_cast<bool>(out);
+}
+
+void PipelineTrace::clear()
+{
+    std::vector<std::shared_ptr<ThreadTrace>> threads;
+    {
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.guard);
+        threads = r.threads;
+    }
+    for (const auto& thread : threads)
+    {
+        std::unique_lock<std::mutex> lock(thread->guard);
+        thread->next = 0;
+        thread->wrapped = false;
+    }
+}
+
+ScopedTraceEvent::ScopedTraceEvent(const char *name)
+    : name(name)
+    , begin(PipelineTrace::Clock::now())
+{
+}
+
+ScopedTraceEvent::ScopedTraceEvent(const char *name, const FrameInfo &info)
+    : name(name)
+    , begin(PipelineTrace::Clock::now())
+{
+    PipelineTrace::setCurrentFrame(info);
+}
+
+ScopedTraceEvent::~ScopedTraceEvent()
+{
+    PipelineTrace::record(name, begin, PipelineTrace::Clock::now());
+}
+
+void ScopedTraceEvent::setFrame(const FrameInfo &info)
+{
+    PipelineTrace::setCurrentFrame(info);
+}
@@ -0,0 +1,60 @@
+#ifndef PIPELINETRACE_H
+#define PIPELINETRACE_H
+
+#include "framesource.h"
+
+#include <chrono>
+#include <string>
+
+//optional tracing of pipeline threads, each thread keeps last events in its own ring buffer,
+//events carry capture timestamp of processed frame, so one frame can be followed from camera to view
+class PipelineTrace
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    //events kept per thread
+    static const size_t ringCapacity = 16384;
+
+    static void setEnabled(bool enabled);
+
+    static bool isEnabled();
+
+    //name of calling thread in trace viewer
+    static void setThreadName(const std::string& name);
+
+    //frame of events recorded later by calling thread
+    static void setCurrentFrame(const FrameInfo& info);
+
+    //name should be string literal, it is stored as pointer
+    static void record(const char* name, Clock::time_point begin, Clock::time_point end);
+
+    //Chrome trace event format, opens in chrome://tracing and Perfetto
+    static bool writeChromeTrace(const std::string& fileName);
+
+    static void clear();
+};
+
+//traces lifetime of the scope as event of the current frame
+class ScopedTraceEvent
+{
+public:
+    explicit ScopedTraceEvent(const char* name);
+
+    ScopedTraceEvent(const char* name, const FrameInfo& info);
+
+    ~ScopedTraceEvent();
+
+    ScopedTraceEvent(const ScopedTraceEvent&) = delete;
+
+    ScopedTraceEvent& operator=(const ScopedTraceEvent&) = delete;
+
+    //frame known only after the event started
+    void setFrame(const FrameInfo& info);
+
+private:
+    const char* name;
+    PipelineTrace::Clock::time_point begin;
+};
+
+#endif // PIPELINETRACE_H
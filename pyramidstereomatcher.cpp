@@ -0,0 +1,355 @@
+#include "pyramidstereomatcher.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+const int noEstimate = std::numeric_limits<int>::min();
+//census has 24 bits, pixel cost never exceeds it
+const int maxCensusCost = 24;
+
+inline int bitsCount(unsigned v)
+{
+    v = v - ((v >> 1) & 0x55555555);
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    return static_cast<int>((((v + (v >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+}
+
+int floorDiv(int a, int b)
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+//5x5 census without center pixel, borders are zero
+class CensusBody : public cv::ParallelLoopBody
+{
+public:
+    CensusBody(const cv::Mat& img, cv::Mat& census)
+        : img(img)
+        , census(census)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        const int w = img.cols;
+        for (int y = range.start; y < range.end; ++y)
+        {
+            int* out = census.ptr<int>(y);
+            std::fill(out, out + w, 0);
+            if (y < 2 || y >= img.rows - 2 || w < 5)
+            {
+                continue;
+            }
+            const uchar* c = img.ptr<uchar>(y);
+            int bit = 0;
+            for (int dy = -2; dy <= 2; ++dy)
+            {
+                for (int dx = -2; dx <= 2; ++dx)
+                {
+                    if (dy == 0 && dx == 0)
+                    {
+                        continue;
+                    }
+                    const uchar* n = img.ptr<uchar>(y + dy) + dx;
+                    const int mask = 1 << bit;
+                    #pragma omp simd
+                    for (int x = 2; x < w - 2; ++x)
+                    {
+                        out[x] |= n[x] < c[x] ? mask : 0;
+                    }
+                    ++bit;
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat& img;
+    cv::Mat& census;
+};
+
+//coarse disparity scaled to full resolution, in whole pixels
+class EstimateBody : public cv::ParallelLoopBody
+{
+public:
+    EstimateBody(const cv::Mat& coarseDisp, int levels, int coarseMinDisparity, cv::Mat& estimate)
+        : coarseDisp(coarseDisp)
+        , levels(levels)
+        , coarseMinDisparity(coarseMinDisparity)
+        , estimate(estimate)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        const int scale = 1 << levels;
+        const int invalid = coarseMinDisparity * cv::StereoMatcher::DISP_SCALE;
+        for (int y = range.start; y < range.end; ++y)
+        {
+            const short* src = coarseDisp.ptr<short>(std::min(y >> levels, coarseDisp.rows - 1));
+            int* dst = estimate.ptr<int>(y);
+            for (int x = 0; x < estimate.cols; ++x)
+            {
+                const int v = src[std::min(x >> levels, coarseDisp.cols - 1)];
+                dst[x] = v < invalid ? noEstimate : cvRound(v * scale / static_cast<double>(cv::StereoMatcher::DISP_SCALE));
+            }
+        }
+    }
+
+private:
+    const cv::Mat& coarseDisp;
+    int levels;
+    int coarseMinDisparity;
+    cv::Mat& estimate;
+};
+
+//census costs of candidates around estimate of each pixel are summed over refinement window,
+//neighbours are matched at disparities of the centre pixel, so windows crossing blocks of
+//different coarse disparity still sum costs of the same disparity
+class RefineBody : public cv::ParallelLoopBody
+{
+public:
+    RefineBody(const cv::Mat& leftCensus, const cv::Mat& rightCensus, const cv::Mat& estimate,
+               int minDisparity, int numDisparities, int searchRadius, cv::Mat& disp)
+        : leftCensus(leftCensus)
+        , rightCensus(rightCensus)
+        , estimate(estimate)
+        , minDisparity(minDisparity)
+        , numDisparities(numDisparities)
+        , searchRadius(searchRadius)
+        , disp(disp)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        std::vector<int> sums(2 * searchRadius + 1);
+        for (int y = range.start; y < range.end; ++y)
+        {
+            refineRow(y, sums.data());
+        }
+    }
+
+private:
+    //window costs of candidates of pixel x, window rows and columns outside of the frame are replicated
+    void windowCost(int y, int x, int firstDisparity, int* sums) const
+    {
+        const int w = disp.cols;
+        const int candidates = 2 * searchRadius + 1;
+        const int half = PyramidStereoMatcher::refinementWindow / 2;
+        std::fill(sums, sums + candidates, 0);
+        for (int dy = -half; dy <= half; ++dy)
+        {
+            const int yy = std::min(std::max(y + dy, 0), disp.rows - 1);
+            const int* l = leftCensus.ptr<int>(yy);
+            const int* r = rightCensus.ptr<int>(yy);
+            for (int dx = -half; dx <= half; ++dx)
+            {
+                const int xx = std::min(std::max(x + dx, 0), w - 1);
+                const unsigned lv = static_cast<unsigned>(l[xx]);
+                //candidate i is disparity firstDisparity + i, its right pixel is xr0 - i
+                const int xr0 = xx - firstDisparity;
+                if (xr0 < w && xr0 - candidates + 1 >= 0)
+                {
+                    const int* rr = r + xr0;
+                    #pragma omp simd
+                    for (int i = 0; i < candidates; ++i)
+                    {
+                        sums[i] += bitsCount(lv ^ static_cast<unsigned>(rr[-i]));
+                    }
+                    continue;
+                }
+                for (int i = 0; i < candidates; ++i)
+                {
+                    const int xr = xr0 - i;
+                    sums[i] += xr >= 0 && xr < w ? bitsCount(lv ^ static_cast<unsigned>(r[xr])) : maxCensusCost;
+                }
+            }
+        }
+    }
+
+    //best candidate with parabolic subpixel interpolation, candidates outside of range are skipped
+    void refineRow(int y, int* sums) const
+    {
+        const int w = disp.cols;
+        const int candidates = 2 * searchRadius + 1;
+        const short invalid = static_cast<short>((minDisparity - 1) * cv::StereoMatcher::DISP_SCALE);
+        const int* e = estimate.ptr<int>(y);
+        short* out = disp.ptr<short>(y);
+        for (int x = 0; x < w; ++x)
+        {
+            out[x] = invalid;
+            if (e[x] == noEstimate)
+            {
+                continue;
+            }
+            const int first = std::max(0, minDisparity - e[x] + searchRadius);
+            const int last = std::min(candidates - 1,
+                                      std::min(minDisparity + numDisparities - 1, x) - e[x] + searchRadius);
+            if (first > last)
+            {
+                continue;
+            }
+
+            windowCost(y, x, e[x] - searchRadius, sums);
+
+            int best = first;
+            for (int i = first + 1; i <= last; ++i)
+            {
+                if (sums[i] < sums[best])
+                {
+                    best = i;
+                }
+            }
+            int d16 = (e[x] + best - searchRadius) * cv::StereoMatcher::DISP_SCALE;
+            if (best > first && best < last)
+            {
+                const int denom2 = std::max(sums[best - 1] + sums[best + 1] - 2 * sums[best], 1);
+                d16 += ((sums[best - 1] - sums[best + 1]) * cv::StereoMatcher::DISP_SCALE + denom2) / (denom2 * 2);
+            }
+            out[x] = static_cast<short>(d16);
+        }
+    }
+
+private:
+    const cv::Mat& leftCensus;
+    const cv::Mat& rightCensus;
+    const cv::Mat& estimate;
+    int minDisparity;
+    int numDisparities;
+    int searchRadius;
+    cv::Mat& disp;
+};
+
+}
+
+cv::Ptr<PyramidStereoMatcher> PyramidStereoMatcher::create(const cv::Ptr<cv::StereoSGBM>& matcher,
+                                                           int levels, int searchRadius)
+{
+    return cv::makePtr<PyramidStereoMatcher>(matcher, levels, searchRadius);
+}
+
+PyramidStereoMatcher::PyramidStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher, int levels, int searchRadius)
+    : matcher(matcher)
+    , levels(std::min(std::max(levels, 0), maxLevels))
+    , searchRadius(std::max(searchRadius, 1))
+    , coarseLevels(-1)
+{
+}
+
+void PyramidStereoMatcher::compute(cv::InputArray leftArr, cv::InputArray rightArr, cv::OutputArray dispArr)
+{
+    cv::Mat left = leftArr.getMat();
+    cv::Mat right = rightArr.getMat();
+    CV_Assert(left.size() == right.size() && left.type() == right.type() && left.depth() == CV_8U);
+
+    if (left.channels() == 3)
+    {
+        cv::Mat leftGray, rightGray;
+        cv::cvtColor(left, leftGray, CV_BGR2GRAY);
+        cv::cvtColor(right, rightGray, CV_BGR2GRAY);
+        left = leftGray;
+        right = rightGray;
+    }
+
+    const MatcherParams params(*matcher);
+    int levelsCount = 0;
+    int radius = 0;
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        levelsCount = levels;
+        radius = searchRadius;
+    }
+    updateCoarseMatcher(params, levelsCount);
+
+    if (levelsCount == 0)
+    {
+        coarseMatcher->compute(left, right, dispArr);
+        return;
+    }
+
+    cv::pyrDown(left, leftCoarse);
+    cv::pyrDown(right, rightCoarse);
+    for (int i = 1; i < levelsCount; ++i)
+    {
+        cv::pyrDown(leftCoarse, leftCoarse);
+        cv::pyrDown(rightCoarse, rightCoarse);
+    }
+    coarseMatcher->compute(leftCoarse, rightCoarse, coarseDisp);
+
+    cv::Mat estimate(left.size(), CV_32S);
+    cv::parallel_for_(cv::Range(0, left.rows),
+                      EstimateBody(coarseDisp, levelsCount, coarseMatcher->getMinDisparity(), estimate));
+
+    leftCensus.create(left.size(), CV_32S);
+    rightCensus.create(right.size(), CV_32S);
+    cv::parallel_for_(cv::Range(0, left.rows), CensusBody(left, leftCensus));
+    cv::parallel_for_(cv::Range(0, right.rows), CensusBody(right, rightCensus));
+
+    dispArr.create(left.size(), CV_16S);
+    cv::Mat disp = dispArr.getMat();
+    cv::parallel_for_(cv::Range(0, left.rows),
+                      RefineBody(leftCensus, rightCensus, estimate,
+                                 params.minDisparity, params.numDisparities, radius, disp));
+
+    if (params.speckleWindowSize > 0)
+    {
+        cv::filterSpeckles(disp, (params.minDisparity - 1) * cv::StereoMatcher::DISP_SCALE,
+                           params.speckleWindowSize, cv::StereoMatcher::DISP_SCALE * params.speckleRange,
+                           speckleBuffer);
+    }
+}
+
+void PyramidStereoMatcher::updateCoarseMatcher(const MatcherParams& params, int levels)
+{
+    if (coarseMatcher && params == coarseSource && levels == coarseLevels)
+    {
+        return;
+    }
+
+    //disparity range, speckle size and range shrink with resolution
+    const int scale = 1 << levels;
+    MatcherParams coarse = params;
+    coarse.minDisparity = floorDiv(params.minDisparity, scale);
+    const int maxDisparity = (params.minDisparity + params.numDisparities + scale - 1) / scale;
+    coarse.numDisparities = std::max(16, (maxDisparity - coarse.minDisparity + 15) / 16 * 16);
+    coarse.speckleWindowSize = params.speckleWindowSize / (scale * scale);
+    coarse.speckleRange = std::max(1, params.speckleRange / scale);
+
+    coarseMatcher = coarse.createMatcher();
+    coarseSource = params;
+    coarseLevels = levels;
+}
+
+cv::Ptr<cv::StereoSGBM> PyramidStereoMatcher::getMatcher() const
+{
+    return matcher;
+}
+
+int PyramidStereoMatcher::getLevels() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return levels;
+}
+
+void PyramidStereoMatcher::setLevels(int levels)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    this->levels = std::min(std::max(levels, 0), maxLevels);
+}
+
+int PyramidStereoMatcher::getSearchRadius() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return searchRadius;
+}
+
+void PyramidStereoMatcher::setSearchRadius(int radius)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    searchRadius = std::max(radius, 1);
+}
@@ -0,0 +1,63 @@
+#ifndef PYRAMIDSTEREOMATCHER_H
+#define PYRAMIDSTEREOMATCHER_H
+
+#include "matcherparams.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <mutex>
+
+//matches downscaled pair with copy of wrapped matcher, then refines each pixel at full resolution
+//by census block matching in narrow window around upscaled coarse disparity
+class PyramidStereoMatcher : public WrappedStereoMatcher
+{
+public:
+    static const int defaultLevels = 2;
+    //levels are clamped to this, coarser frames are too small to match
+    static const int maxLevels = 4;
+    static const int defaultSearchRadius = 4;
+    //census cost is summed over this window during refinement
+    static const int refinementWindow = 5;
+
+    static cv::Ptr<PyramidStereoMatcher> create(const cv::Ptr<cv::StereoSGBM>& matcher,
+                                                int levels = defaultLevels,
+                                                int searchRadius = defaultSearchRadius);
+
+    PyramidStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher, int levels, int searchRadius);
+
+    //should be called from one thread at a time
+    void compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) override;
+
+    cv::Ptr<cv::StereoSGBM> getMatcher() const override;
+
+    //each level halves resolution of coarse matching
+    int getLevels() const;
+    void setLevels(int levels);
+
+    //disparities searched on each side of upscaled estimate
+    int getSearchRadius() const;
+    void setSearchRadius(int radius);
+
+private:
+    //recreates coarse matcher when parameters of wrapped one or levels were changed
+    void updateCoarseMatcher(const MatcherParams& params, int levels);
+
+private:
+    cv::Ptr<cv::StereoSGBM> matcher;
+    int levels;
+    int searchRadius;
+
+    MatcherParams coarseSource;
+    int coarseLevels;
+    cv::Ptr<cv::StereoSGBM> coarseMatcher;
+
+    cv::Mat leftCoarse;
+    cv::Mat rightCoarse;
+    cv::Mat coarseDisp;
+    cv::Mat leftCensus;
+    cv::Mat rightCensus;
+    cv::Mat speckleBuffer;
+    mutable std::mutex guard;
+};
+
+#endif // PYRAMIDSTEREOMATCHER_H
@@ -1,12 +1,27 @@
 #include "qframeconverter.h"
+#include "stagestats.h"
+#include "pipelinetrace.h"
 
 #include <QTimerEvent>
 #include <QImage>
 #include <QThread>
 
+namespace
+{
+    //keeps frame buffer alive while QImage uses it
+    void releaseFrame(void* info)
+    {
+        delete static_cast<FramePtr*>(info);
+    }
+}
+
 QFrameConverter::QFrameConverter(QObject *parent)
     : QObject(parent)
+    , frameSource(nullptr)
+    , frameGeneration(0)
     , stopTimer(false)
+    , pauseProcessing(false)
+    , threadStarted(false)
 {
 
 }
@@ -14,7 +29,10 @@ QFrameConverter::QFrameConverter(QObject *parent)
 QFrameConverter::QFrameConverter(FrameSource& frameSource, QObject *parent)
     : QObject(parent)
     , frameSource(&frameSource)
+    , frameGeneration(0)
     , stopTimer(false)
+    , pauseProcessing(false)
+    , threadStarted(false)
 {
     timer.start(0, this);
 }
@@ -32,14 +50,36 @@ void QFrameConverter::timerEvent(QTimerEvent * ev)
     }
     else
     {
-        if (!pauseProcessing)
+        if (!threadStarted)
         {
-            frameSource->getFrame(frame);
+            cpuUsage.startThread();
+            PipelineTrace::setThreadName("converter");
+            threadStarted = true;
+        }
 
-            if (!frame.empty())
+        if (pauseProcessing || frameSource == nullptr)
+        {
+            QThread::msleep(50);
+        }
+        else
+        {
+            //wait for new frame instead of converting the same one again
+            auto generation = frameSource->waitFrame(frameGeneration, 50);
+            bool newFrame = generation != frameGeneration;
+            FrameInfo info;
+
+            if (newFrame)
+            {
+                frameGeneration = generation;
+                frameSource->getFrame(frame, info);
+            }
+
+            if (newFrame && frame && !frame->empty())
             {
+                ScopedTraceEvent frameEvent("convert frame", info);
+                ScopedStageTimer timer(StageStatistics::STAGE_QT_CONVERT);
                 QImage::Format format(QImage::Format_RGB888);
-                switch (frame.channels())
+                switch (frame->channels())
                 {
                 case 1:
                     format = QImage::Format_Grayscale8;
@@ -51,13 +91,16 @@ void QFrameConverter::timerEvent(QTimerEvent * ev)
                     Q_ASSERT(false);
                 }
 
-                const QImage image(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step), format);
+                const QImage image(frame->data, frame->cols, frame->rows, static_cast<int>(frame->step), format,
+                                   releaseFrame, new FramePtr(frame));
 
-                Q_ASSERT(image.constBits() == frame.data);
+                Q_ASSERT(image.constBits() == frame->data);
 
                 emit imageReady(image);
             }
         }
+
+        cpuUsage.update();
     }
 
     if (stopTimer)
@@ -78,6 +121,12 @@ void QFrameConverter::stop()
 void QFrameConverter::setFrameSource(FrameSource &frameSource)
 {
     this->frameSource = &frameSource;
+    frameGeneration = 0;
     timer.start(0, this);
 }
 
+double QFrameConverter::getCpuUsage()
+{
+    return cpuUsage.getUsage();
+}
+
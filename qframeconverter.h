@@ -2,6 +2,7 @@
 #define QFRAMECONVERTER_H
 
 #include "framesource.h"
+#include "cpuusage.h"
 
 #include <QObject>
 #include <qbasictimer.h>
@@ -25,12 +26,17 @@ public:
 
     void setFrameSource(FrameSource& frameSource);
 
+    double getCpuUsage();
+
 private:
     FrameSource* frameSource;
     QBasicTimer timer;
-    cv::Mat frame;
+    FramePtr frame;
+    unsigned long long frameGeneration;
     bool stopTimer;
     bool pauseProcessing;
+    bool threadStarted;
+    CpuUsageCounter cpuUsage;
 };
 
 #endif // QFRAMECONVERTER_H
@@ -0,0 +1,235 @@
+#include "recordedstream.h"
+
+#include <cstdint>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace
+{
+
+const char streamMagic[8] = {'S', 'C', 'S', 'T', 'R', 'M', '0', '1'};
+
+//fields are stored in host byte order
+struct FileHeader
+{
+    char magic[8];
+    uint32_t width;
+    uint32_t height;
+};
+
+struct RecordHeader
+{
+    uint64_t timestamp;
+    uint32_t sequence;
+    uint32_t size;
+};
+
+}
+
+bool isCompleteJpeg(const char* data, size_t size)
+{
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+    if (size < 4 || bytes[0] != 0xFF || bytes[1] != 0xD8)
+    {
+        return false;
+    }
+    size_t end = size;
+    while (end > 2 && bytes[end - 1] == 0)
+    {
+        --end;
+    }
+    return end >= 4 && bytes[end - 2] == 0xFF && bytes[end - 1] == 0xD9;
+}
+
+StreamWriter::StreamWriter()
+    : file(nullptr)
+    , framesCount(0)
+{
+}
+
+StreamWriter::~StreamWriter()
+{
+    close();
+}
+
+bool StreamWriter::open(const std::string &fileName, int width, int height)
+{
+    close();
+    file = std::fopen(fileName.c_str(), "wb");
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    FileHeader header;
+    std::memcpy(header.magic, streamMagic, sizeof(header.magic));
+    header.width = static_cast<uint32_t>(width);
+    header.height = static_cast<uint32_t>(height);
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void StreamWriter::close()
+{
+    if (file != nullptr)
+    {
+        std::fclose(file);
+        file = nullptr;
+    }
+    framesCount = 0;
+}
+
+bool StreamWriter::isOpen() const
+{
+    return file != nullptr;
+}
+
+bool StreamWriter::write(const char *data, size_t size, const FrameInfo &info)
+{
+    if (file == nullptr || size > UINT32_MAX)
+    {
+        return false;
+    }
+
+    RecordHeader header;
+    header.timestamp = info.timestamp;
+    header.sequence = info.sequence;
+    header.size = static_cast<uint32_t>(size);
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1 ||
+        std::fwrite(data, 1, size, file) != size)
+    {
+        return false;
+    }
+    ++framesCount;
+    return true;
+}
+
+unsigned long long StreamWriter::getFramesCount() const
+{
+    return framesCount;
+}
+
+StreamReader::StreamReader()
+    : fd(-1)
+    , mapping(nullptr)
+    , length(0)
+    , width(0)
+    , height(0)
+{
+}
+
+StreamReader::~StreamReader()
+{
+    close();
+}
+
+bool StreamReader::open(const std::string &fileName)
+{
+    close();
+    fd = ::open(fileName.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || static_cast<size_t>(st.st_size) < sizeof(FileHeader))
+    {
+        close();
+        return false;
+    }
+    length = static_cast<size_t>(st.st_size);
+
+    mapping = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED)
+    {
+        mapping = nullptr;
+        close();
+        return false;
+    }
+    //frames are read once in order
+    madvise(mapping, length, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(mapping);
+    FileHeader header;
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, streamMagic, sizeof(header.magic)) != 0)
+    {
+        close();
+        return false;
+    }
+    width = static_cast<int>(header.width);
+    height = static_cast<int>(header.height);
+
+    //incomplete last record is dropped
+    size_t offset = sizeof(FileHeader);
+    while (length - offset >= sizeof(RecordHeader))
+    {
+        RecordHeader recordHeader;
+        std::memcpy(&recordHeader, base + offset, sizeof(recordHeader));
+        offset += sizeof(RecordHeader);
+        if (length - offset < recordHeader.size)
+        {
+            break;
+        }
+        Record record;
+        record.data = base + offset;
+        record.size = recordHeader.size;
+        record.info = FrameInfo(recordHeader.timestamp, recordHeader.sequence);
+        records.push_back(record);
+        offset += recordHeader.size;
+    }
+    return true;
+}
+
+void StreamReader::close()
+{
+    records.clear();
+    if (mapping != nullptr)
+    {
+        munmap(mapping, length);
+        mapping = nullptr;
+    }
+    length = 0;
+    if (fd >= 0)
+    {
+        ::close(fd);
+        fd = -1;
+    }
+    width = 0;
+    height = 0;
+}
+
+bool StreamReader::isOpen() const
+{
+    return mapping != nullptr;
+}
+
+int StreamReader::getWidth() const
+{
+    return width;
+}
+
+int StreamReader::getHeight() const
+{
+    return height;
+}
+
+size_t StreamReader::getFramesCount() const
+{
+    return records.size();
+}
+
+const StreamReader::Record& StreamReader::getRecord(size_t index) const
+{
+    return records[index];
+}
@@ -0,0 +1,87 @@
+#ifndef RECORDEDSTREAM_H
+#define RECORDEDSTREAM_H
+
+#include "framesource.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+//cheap check of MJPEG payload before decoding, false if SOI or EOI marker is missing,
+//drivers may pad payload with zeros after EOI
+bool isCompleteJpeg(const char* data, size_t size);
+
+//append-only container of raw camera payloads (MJPEG), file header is followed by records
+//of fixed header and payload, so recording cut by crash stays readable up to last complete record
+
+class StreamWriter
+{
+public:
+    StreamWriter();
+
+    ~StreamWriter();
+
+    StreamWriter(const StreamWriter&) = delete;
+
+    StreamWriter& operator=(const StreamWriter&) = delete;
+
+    //size of decoded frames, existing file is truncated
+    bool open(const std::string& fileName, int width, int height);
+
+    void close();
+
+    bool isOpen() const;
+
+    bool write(const char* data, size_t size, const FrameInfo& info);
+
+    unsigned long long getFramesCount() const;
+
+private:
+    std::FILE* file;
+    unsigned long long framesCount;
+};
+
+//memory-mapped recording, index of records is built on open by walking record headers
+class StreamReader
+{
+public:
+    struct Record
+    {
+        const char* data;
+        size_t size;
+        FrameInfo info;
+    };
+
+    StreamReader();
+
+    ~StreamReader();
+
+    StreamReader(const StreamReader&) = delete;
+
+    StreamReader& operator=(const StreamReader&) = delete;
+
+    bool open(const std::string& fileName);
+
+    void close();
+
+    bool isOpen() const;
+
+    int getWidth() const;
+
+    int getHeight() const;
+
+    size_t getFramesCount() const;
+
+    //payload points into mapping and is valid until close
+    const Record& getRecord(size_t index) const;
+
+private:
+    int fd;
+    void* mapping;
+    size_t length;
+    int width;
+    int height;
+    std::vector<Record> records;
+};
+
+#endif // RECORDEDSTREAM_H
@@ -0,0 +1,98 @@
+#include "rectifier.h"
+#include "stagestats.h"
+
+Rectifier::Rectifier()
+    : framePool(16) //colour and gray buffers, held by display and stereo synchronizer queues
+{
+}
+
+void Rectifier::setFrame(const FramePtr& frame, const FrameInfo& info)
+{
+    FramePtr color = frame;
+    FramePtr gray;
+
+    if (frame && !frame->empty())
+    {
+        RectifyMap map;
+        {
+            std::unique_lock<std::mutex> lock(mapGuard);
+            map = rectifyMap;
+            inputSize = frame->size();
+        }
+
+        if (!map.empty())
+        {
+            cv::Size size = map.size();
+            auto colorBuffer = framePool.acquire(size.height, size.width, frame->type());
+            auto grayBuffer = framePool.acquire(size.height, size.width, CV_8UC1);
+            ScopedStageTimer timer(StageStatistics::STAGE_RECTIFY);
+            map.remapColorGray(*frame, *colorBuffer, *grayBuffer);
+            color = colorBuffer;
+            gray = grayBuffer;
+        }
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(outGuard);
+        outFrame = color;
+        outGray = gray;
+        outFrameInfo = info;
+    }
+    notifyFrame();
+
+    std::unique_lock<std::mutex> lock(callbackGuard);
+    if (frameCallback)
+    {
+        frameCallback(color, info);
+    }
+}
+
+void Rectifier::setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func)
+{
+    std::unique_lock<std::mutex> lock(callbackGuard);
+    frameCallback = func;
+}
+
+void Rectifier::getFrame(FramePtr& frame, FrameInfo& info)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    frame = outFrame;
+    info = outFrameInfo;
+}
+
+void Rectifier::getFrame(FramePtr& frame, FramePtr& gray, FrameInfo& info)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    frame = outFrame;
+    gray = outGray;
+    info = outFrameInfo;
+}
+
+void Rectifier::setMapping(const RectifyMap& map)
+{
+    std::unique_lock<std::mutex> lock(mapGuard);
+    rectifyMap = map;
+}
+
+void Rectifier::resetMapping()
+{
+    std::unique_lock<std::mutex> lock(mapGuard);
+    rectifyMap = RectifyMap();
+}
+
+bool Rectifier::hasMapping() const
+{
+    std::unique_lock<std::mutex> lock(mapGuard);
+    return !rectifyMap.empty();
+}
+
+cv::Size Rectifier::getInputSize() const
+{
+    std::unique_lock<std::mutex> lock(mapGuard);
+    return inputSize;
+}
+
+FramePool::Statistics Rectifier::getPoolStatistics() const
+{
+    return framePool.getStatistics();
+}
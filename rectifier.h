@@ -0,0 +1,60 @@
+#ifndef RECTIFIER_H
+#define RECTIFIER_H
+
+#include "framesource.h"
+#include "rectifymap.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <functional>
+#include <mutex>
+
+//first stage after camera, rectifies each frame once when stereo calibration is loaded,
+//result is shared by display processing and depth map builder
+class Rectifier : public FrameSource
+{
+public:
+    Rectifier();
+
+    Rectifier(const Rectifier&) = delete;
+
+    Rectifier& operator=(const Rectifier&) = delete;
+
+    //called from camera thread, published frame is also passed to the callback
+    void setFrame(const FramePtr& frame, const FrameInfo& info);
+
+    void setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func);
+
+    void getFrame(FramePtr& frame, FrameInfo& info) override;
+
+    //gray is produced only together with rectification, otherwise it is empty
+    void getFrame(FramePtr& frame, FramePtr& gray, FrameInfo& info);
+
+    void setMapping(const RectifyMap& map);
+
+    void resetMapping();
+
+    bool hasMapping() const;
+
+    //size of frames before rectification, mappings should be built for it
+    cv::Size getInputSize() const;
+
+    FramePool::Statistics getPoolStatistics() const;
+
+private:
+    std::function<void (const FramePtr&, const FrameInfo&)> frameCallback;
+    std::mutex callbackGuard;
+
+    RectifyMap rectifyMap;
+    cv::Size inputSize;
+    mutable std::mutex mapGuard;
+
+    FramePtr outFrame;
+    FramePtr outGray;
+    FrameInfo outFrameInfo;
+    std::mutex outGuard;
+
+    FramePool framePool;
+};
+
+#endif // RECTIFIER_H
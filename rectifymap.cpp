@@ -0,0 +1,100 @@
+#include "rectifymap.h"
+
+namespace
+{
+
+class RemapColorGrayBody : public cv::ParallelLoopBody
+{
+public:
+    RemapColorGrayBody(const cv::Mat& src, const cv::Mat& map1, const cv::Mat& map2,
+                       cv::Mat& color, cv::Mat& gray, int bandRows)
+        : src(src)
+        , map1(map1)
+        , map2(map2)
+        , color(color)
+        , gray(gray)
+        , bandRows(bandRows)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        for (int band = range.start; band < range.end; ++band)
+        {
+            cv::Range rows(band * bandRows, std::min((band + 1) * bandRows, color.rows));
+            //views of preallocated outputs, so nothing is reallocated here
+            cv::Mat colorBand = color.rowRange(rows);
+            cv::Mat grayBand = gray.rowRange(rows);
+            cv::remap(src, colorBand, map1.rowRange(rows), map2.rowRange(rows), cv::INTER_LINEAR);
+            //band is still in cache
+            cv::cvtColor(colorBand, grayBand, CV_BGR2GRAY);
+        }
+    }
+
+private:
+    const cv::Mat& src;
+    const cv::Mat& map1;
+    const cv::Mat& map2;
+    cv::Mat& color;
+    cv::Mat& gray;
+    int bandRows;
+};
+
+}
+
+RectifyMap::RectifyMap()
+{
+}
+
+void RectifyMap::init(const cv::Mat &cameraMatrix, const cv::Mat &distCoeffs,
+                      const cv::Mat &R, const cv::Mat &P,
+                      const cv::Size &imgSize, const cv::Rect &roi)
+{
+    cv::Mat mapx, mapy;
+    cv::initUndistortRectifyMap(cameraMatrix, distCoeffs, R, P, imgSize, CV_32FC1, mapx, mapy);
+
+    cv::Mat fixedMap1, fixedMap2;
+    cv::convertMaps(mapx, mapy, fixedMap1, fixedMap2, CV_16SC2);
+
+    //maps can be shared by copies, so always keep new buffers
+    this->roi = roi & cv::Rect(cv::Point(0, 0), imgSize);
+    map1 = fixedMap1(this->roi).clone();
+    map2 = fixedMap2(this->roi).clone();
+}
+
+bool RectifyMap::empty() const
+{
+    return map1.empty();
+}
+
+cv::Size RectifyMap::size() const
+{
+    return map1.size();
+}
+
+cv::Rect RectifyMap::getRoi() const
+{
+    return roi;
+}
+
+void RectifyMap::remap(const cv::Mat &src, cv::Mat &dst) const
+{
+    cv::remap(src, dst, map1, map2, cv::INTER_LINEAR);
+}
+
+void RectifyMap::remapColorGray(const cv::Mat &src, cv::Mat &color, cv::Mat &gray) const
+{
+    if (src.channels() != 3)
+    {
+        remap(src, color);
+        gray = color;
+        return;
+    }
+
+    color.create(map1.size(), src.type());
+    gray.create(map1.size(), CV_8UC1);
+
+    const int bandRows = 32;
+    const int bands = (color.rows + bandRows - 1) / bandRows;
+    cv::parallel_for_(cv::Range(0, bands), RemapColorGrayBody(src, map1, map2, color, gray, bandRows));
+}
@@ -0,0 +1,35 @@
+#ifndef RECTIFYMAP_H
+#define RECTIFYMAP_H
+
+#include <opencv2/opencv.hpp>
+
+//fixed-point undistort/rectify mapping already cropped to the valid region,
+//remap result has roi size so no separate crop is needed
+class RectifyMap
+{
+public:
+    RectifyMap();
+
+    void init(const cv::Mat& cameraMatrix, const cv::Mat& distCoeffs,
+              const cv::Mat& R, const cv::Mat& P,
+              const cv::Size& imgSize, const cv::Rect& roi);
+
+    bool empty() const;
+
+    //size of remapped image
+    cv::Size size() const;
+
+    cv::Rect getRoi() const;
+
+    void remap(const cv::Mat& src, cv::Mat& dst) const;
+
+    //remaps color image and converts it to gray in the same pass over row bands
+    void remapColorGray(const cv::Mat& src, cv::Mat& color, cv::Mat& gray) const;
+
+private:
+    cv::Mat map1; //CV_16SC2 integer coordinates
+    cv::Mat map2; //CV_16UC1 interpolation table indices
+    cv::Rect roi;
+};
+
+#endif // RECTIFYMAP_H
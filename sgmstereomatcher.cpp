@@ -0,0 +1,732 @@
+#include "sgmstereomatcher.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SGM_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+
+const int censusPlanesCount = 3;
+//path costs of pixel are stored with padding, so neighbour disparities are read without checks
+const int slotPadding = 32;
+
+struct SgmParams
+{
+    int width;
+    int height;
+    int minDisparity;
+    int numDisparities;
+    int alignedDisparities; //multiple of 32, extra disparities have max cost
+    int P1;
+    int P2;
+    int uniquenessRatio;
+    int disp12MaxDiff;
+};
+
+inline int bitsCount(unsigned v)
+{
+    v = v - ((v >> 1) & 0x55);
+    v = (v & 0x33) + ((v >> 2) & 0x33);
+    return (v + (v >> 4)) & 0x0F;
+}
+
+#ifdef SGM_X86
+bool hasAVX2()
+{
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    return avx2;
+}
+#endif
+
+//5x5 census without center pixel, 24 bits are stored in 3 byte planes
+class CensusBody : public cv::ParallelLoopBody
+{
+public:
+    CensusBody(const cv::Mat& img, cv::Mat* planes)
+        : img(img)
+        , planes(planes)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        const int w = img.cols;
+        for (int y = range.start; y < range.end; ++y)
+        {
+            uchar* out[censusPlanesCount];
+            for (int p = 0; p < censusPlanesCount; ++p)
+            {
+                out[p] = planes[p].ptr<uchar>(y);
+                std::fill(out[p], out[p] + w, 0);
+            }
+            if (y < 2 || y >= img.rows - 2 || w < 5)
+            {
+                continue;
+            }
+
+            const uchar* c = img.ptr<uchar>(y);
+            int bit = 0;
+            for (int dy = -2; dy <= 2; ++dy)
+            {
+                for (int dx = -2; dx <= 2; ++dx)
+                {
+                    if (dy == 0 && dx == 0)
+                    {
+                        continue;
+                    }
+                    const uchar* n = img.ptr<uchar>(y + dy) + dx;
+                    uchar* plane = out[bit / 8];
+                    const uchar mask = static_cast<uchar>(1 << (bit % 8));
+                    #pragma omp simd
+                    for (int x = 2; x < w - 2; ++x)
+                    {
+                        plane[x] |= n[x] < c[x] ? mask : 0;
+                    }
+                    ++bit;
+                }
+            }
+        }
+    }
+
+private:
+    const cv::Mat& img;
+    cv::Mat* planes;
+};
+
+void censusTransform(const cv::Mat& img, cv::Mat* planes)
+{
+    for (int p = 0; p < censusPlanesCount; ++p)
+    {
+        planes[p].create(img.size(), CV_8UC1);
+    }
+    cv::parallel_for_(cv::Range(0, img.rows), CensusBody(img, planes));
+}
+
+//costs of pixel x for disparities minD.. are read from reversed right row starting at
+//rev + width - 1 - x + minD, border pixels are replicated
+void reverseRow(const uchar* src, int width, int pad, uchar* dst)
+{
+    const int length = width + 2 * pad;
+    for (int k = 0; k < length; ++k)
+    {
+        int xr = width - 1 - (k - pad);
+        xr = std::min(std::max(xr, 0), width - 1);
+        dst[k] = src[xr];
+    }
+}
+
+void costRowScalar(const SgmParams& p, const uchar* const* left, const uchar* const* rev, int pad, uchar* cost)
+{
+    const int D = p.numDisparities;
+    const int Dp = p.alignedDisparities;
+    for (int x = 0; x < p.width; ++x)
+    {
+        const int k0 = p.width - 1 - x + p.minDisparity + pad;
+        uchar* c = cost + static_cast<size_t>(x) * Dp;
+        for (int d = 0; d < D; ++d)
+        {
+            c[d] = static_cast<uchar>(bitsCount(left[0][x] ^ rev[0][k0 + d]) +
+                                      bitsCount(left[1][x] ^ rev[1][k0 + d]) +
+                                      bitsCount(left[2][x] ^ rev[2][k0 + d]));
+        }
+        std::fill(c + D, c + Dp, 255);
+    }
+}
+
+//Lr(d) = C(d) + min(Lp(d), Lp(d-1) + P1, Lp(d+1) + P1, min(Lp) + P2) - min(Lp)
+//all values fit 8 bits: C <= 24 and P2 <= 200, padding disparities saturate to 255
+int updatePathScalar(const uchar* prev, int prevMin, const uchar* cost, int Dp, int P1, int P2,
+                     uchar* out, ushort* sum)
+{
+    const int p2 = std::min(prevMin + P2, 255);
+    int minLr = 255;
+    #pragma omp simd reduction(min:minLr)
+    for (int d = 0; d < Dp; ++d)
+    {
+        int t = std::min(std::min(prev[d - 1] + P1, prev[d + 1] + P1), 255);
+        t = std::min(std::min(t, static_cast<int>(prev[d])), p2) - prevMin;
+        const int lr = std::min(cost[d] + t, 255);
+        out[d] = static_cast<uchar>(lr);
+        sum[d] = static_cast<ushort>(sum[d] + lr);
+        minLr = std::min(minLr, lr);
+    }
+    return minLr;
+}
+
+void findMinScalar(const ushort* sum, int D, int& minS, int& best)
+{
+    minS = sum[0];
+    best = 0;
+    for (int d = 1; d < D; ++d)
+    {
+        if (sum[d] < minS)
+        {
+            minS = sum[d];
+            best = d;
+        }
+    }
+}
+
+//false if there is other disparity (not adjacent to best) with sum <= limit
+bool isUniqueScalar(const ushort* sum, int D, int best, int limit)
+{
+    for (int d = 0; d < D; ++d)
+    {
+        if (sum[d] <= limit && std::abs(d - best) > 1)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+#ifdef SGM_X86
+__attribute__((target("avx2")))
+inline __m256i bitsCountAVX2(__m256i v)
+{
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i lowMask = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_and_si256(v, lowMask);
+    __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), lowMask);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+}
+
+__attribute__((target("avx2")))
+void costRowAVX2(const SgmParams& p, const uchar* const* left, const uchar* const* rev, int pad, uchar* cost)
+{
+    const int D = p.numDisparities;
+    const int Dp = p.alignedDisparities;
+    const __m256i padCost = _mm256_set1_epi8(static_cast<char>(0xFF));
+    for (int x = 0; x < p.width; ++x)
+    {
+        const int k0 = p.width - 1 - x + p.minDisparity + pad;
+        const __m256i l0 = _mm256_set1_epi8(static_cast<char>(left[0][x]));
+        const __m256i l1 = _mm256_set1_epi8(static_cast<char>(left[1][x]));
+        const __m256i l2 = _mm256_set1_epi8(static_cast<char>(left[2][x]));
+        uchar* c = cost + static_cast<size_t>(x) * Dp;
+        for (int d = 0; d < Dp; d += 32)
+        {
+            __m256i r0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rev[0] + k0 + d));
+            __m256i r1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rev[1] + k0 + d));
+            __m256i r2 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(rev[2] + k0 + d));
+            __m256i v = _mm256_add_epi8(_mm256_add_epi8(bitsCountAVX2(_mm256_xor_si256(l0, r0)),
+                                                        bitsCountAVX2(_mm256_xor_si256(l1, r1))),
+                                        bitsCountAVX2(_mm256_xor_si256(l2, r2)));
+            if (d + 32 > D)
+            {
+                //disparities above D get max cost
+                const __m256i lane = _mm256_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+                                                      16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31);
+                __m256i outside = _mm256_cmpgt_epi8(lane, _mm256_set1_epi8(static_cast<char>(D - d - 1)));
+                v = _mm256_or_si256(v, _mm256_and_si256(outside, padCost));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(c + d), v);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+int updatePathAVX2(const uchar* prev, int prevMin, const uchar* cost, int Dp, int P1, int P2,
+                   uchar* out, ushort* sum)
+{
+    const __m256i p1 = _mm256_set1_epi8(static_cast<char>(P1));
+    const __m256i p2 = _mm256_set1_epi8(static_cast<char>(std::min(prevMin + P2, 255)));
+    const __m256i pm = _mm256_set1_epi8(static_cast<char>(prevMin));
+    __m256i minLr = _mm256_set1_epi8(static_cast<char>(0xFF));
+    for (int d = 0; d < Dp; d += 32)
+    {
+        __m256i lp = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d));
+        __m256i lm = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d - 1));
+        __m256i ln = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + d + 1));
+        __m256i t = _mm256_min_epu8(_mm256_adds_epu8(lm, p1), _mm256_adds_epu8(ln, p1));
+        t = _mm256_min_epu8(_mm256_min_epu8(t, lp), p2);
+        t = _mm256_subs_epu8(t, pm);
+        __m256i lr = _mm256_adds_epu8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(cost + d)), t);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + d), lr);
+        minLr = _mm256_min_epu8(minLr, lr);
+
+        __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + d));
+        __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + d + 16));
+        s0 = _mm256_add_epi16(s0, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(lr)));
+        s1 = _mm256_add_epi16(s1, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(lr, 1)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + d), s0);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + d + 16), s1);
+    }
+    __m128i m = _mm_min_epu8(_mm256_castsi256_si128(minLr), _mm256_extracti128_si256(minLr, 1));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 8));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 4));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 2));
+    m = _mm_min_epu8(m, _mm_srli_si128(m, 1));
+    return _mm_cvtsi128_si32(m) & 0xFF;
+}
+
+__attribute__((target("avx2")))
+void findMinAVX2(const ushort* sum, int D, int& minS, int& best)
+{
+    __m256i m = _mm256_set1_epi16(static_cast<short>(0xFFFF));
+    for (int d = 0; d < D; d += 16)
+    {
+        m = _mm256_min_epu16(m, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + d)));
+    }
+    __m128i m8 = _mm_min_epu16(_mm256_castsi256_si128(m), _mm256_extracti128_si256(m, 1));
+    minS = _mm_cvtsi128_si32(_mm_minpos_epu16(m8)) & 0xFFFF;
+
+    const __m256i mv = _mm256_set1_epi16(static_cast<short>(minS));
+    best = 0;
+    for (int d = 0; d < D; d += 16)
+    {
+        __m256i eq = _mm256_cmpeq_epi16(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + d)), mv);
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(eq));
+        if (mask != 0)
+        {
+            best = d + __builtin_ctz(mask) / 2;
+            break;
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+bool isUniqueAVX2(const ushort* sum, int D, int best, int limit)
+{
+    //sums are below 2^15, so signed compare is fine
+    const __m256i lim = _mm256_set1_epi16(static_cast<short>(std::min(limit, 0x7FFE) + 1));
+    for (int d = 0; d < D; d += 16)
+    {
+        __m256i le = _mm256_cmpgt_epi16(lim, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(sum + d)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_epi8(le));
+        for (int i = std::max(best - 1, d); i <= std::min(best + 1, d + 15); ++i)
+        {
+            mask &= ~(3u << (2 * (i - d)));
+        }
+        if (mask != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+#endif
+
+class SgmBandBody : public cv::ParallelLoopBody
+{
+public:
+    SgmBandBody(const SgmParams& params, const cv::Mat* leftCensus, const cv::Mat* rightCensus,
+                const std::vector<cv::Range>& bands, cv::Mat& disp)
+        : p(params)
+        , leftCensus(leftCensus)
+        , rightCensus(rightCensus)
+        , bands(bands)
+        , disp(disp)
+    {
+    }
+
+    void operator()(const cv::Range& range) const override
+    {
+        for (int i = range.start; i < range.end; ++i)
+        {
+            processBand(bands[i]);
+        }
+    }
+
+private:
+    void processBand(const cv::Range& band) const;
+
+    void selectDisparities(const ushort* sum, short* out) const;
+
+private:
+    SgmParams p;
+    const cv::Mat* leftCensus;
+    const cv::Mat* rightCensus;
+    const std::vector<cv::Range>& bands;
+    cv::Mat& disp;
+};
+
+void SgmBandBody::processBand(const cv::Range& band) const
+{
+    const int w = p.width;
+    const int Dp = p.alignedDisparities;
+    const int pad = Dp + std::abs(p.minDisparity);
+    const int slot = Dp + 2 * slotPadding;
+    //top-left, top and top-right paths
+    const int pathsCount = 3;
+    const int pathDx[pathsCount] = { -1, 0, 1 };
+
+    bool avx2 = false;
+#ifdef SGM_X86
+    avx2 = hasAVX2();
+    auto updatePath = avx2 ? updatePathAVX2 : updatePathScalar;
+    auto costRow = avx2 ? costRowAVX2 : costRowScalar;
+#else
+    auto updatePath = updatePathScalar;
+    auto costRow = costRowScalar;
+#endif
+
+    std::vector<uchar> cost(static_cast<size_t>(w) * Dp);
+    std::vector<ushort> sum(static_cast<size_t>(w) * Dp);
+    std::vector<uchar> rev(censusPlanesCount * static_cast<size_t>(w + 2 * pad));
+    std::vector<uchar> prevPaths(static_cast<size_t>(pathsCount) * w * slot, 255);
+    std::vector<uchar> curPaths(prevPaths.size(), 255);
+    std::vector<int> prevMin(pathsCount * w, 0);
+    std::vector<int> curMin(pathsCount * w, 0);
+    std::vector<uchar> horizontal(2 * slot, 255);
+    std::vector<uchar> zeroSlot(slot, 255);
+    std::fill(zeroSlot.begin() + slotPadding, zeroSlot.begin() + slotPadding + Dp, 0);
+    const uchar* zero = zeroSlot.data() + slotPadding;
+
+    const int start = std::max(0, band.start - SgmStereoMatcher::bandWarmUpRows);
+    for (int y = start; y < band.end; ++y)
+    {
+        const uchar* left[censusPlanesCount];
+        const uchar* revRows[censusPlanesCount];
+        for (int c = 0; c < censusPlanesCount; ++c)
+        {
+            left[c] = leftCensus[c].ptr<uchar>(y);
+            uchar* r = rev.data() + c * static_cast<size_t>(w + 2 * pad);
+            reverseRow(rightCensus[c].ptr<uchar>(y), w, pad, r);
+            revRows[c] = r;
+        }
+        costRow(p, left, revRows, pad, cost.data());
+        std::fill(sum.begin(), sum.end(), 0);
+
+        //left to right and paths from previous row
+        const bool firstRow = y == start;
+        int hMin = 0;
+        for (int x = 0; x < w; ++x)
+        {
+            const uchar* c = cost.data() + static_cast<size_t>(x) * Dp;
+            ushort* s = sum.data() + static_cast<size_t>(x) * Dp;
+
+            const uchar* hPrev = x == 0 ? zero : horizontal.data() + ((x - 1) & 1) * slot + slotPadding;
+            hMin = updatePath(hPrev, x == 0 ? 0 : hMin, c, Dp, p.P1, p.P2,
+                              horizontal.data() + (x & 1) * slot + slotPadding, s);
+
+            for (int k = 0; k < pathsCount; ++k)
+            {
+                const int xp = x + pathDx[k];
+                const uchar* prev = zero;
+                int pm = 0;
+                if (!firstRow && xp >= 0 && xp < w)
+                {
+                    prev = prevPaths.data() + (static_cast<size_t>(k) * w + xp) * slot + slotPadding;
+                    pm = prevMin[k * w + xp];
+                }
+                uchar* out = curPaths.data() + (static_cast<size_t>(k) * w + x) * slot + slotPadding;
+                curMin[k * w + x] = updatePath(prev, pm, c, Dp, p.P1, p.P2, out, s);
+            }
+        }
+
+        //right to left
+        for (int x = w - 1; x >= 0; --x)
+        {
+            const uchar* c = cost.data() + static_cast<size_t>(x) * Dp;
+            ushort* s = sum.data() + static_cast<size_t>(x) * Dp;
+            const uchar* hPrev = x == w - 1 ? zero : horizontal.data() + ((x + 1) & 1) * slot + slotPadding;
+            hMin = updatePath(hPrev, x == w - 1 ? 0 : hMin, c, Dp, p.P1, p.P2,
+                              horizontal.data() + (x & 1) * slot + slotPadding, s);
+        }
+
+        prevPaths.swap(curPaths);
+        prevMin.swap(curMin);
+
+        if (y >= band.start)
+        {
+            selectDisparities(sum.data(), disp.ptr<short>(y));
+        }
+    }
+    (void)avx2;
+}
+
+void SgmBandBody::selectDisparities(const ushort* sum, short* out) const
+{
+    const int w = p.width;
+    const int D = p.numDisparities;
+    const int Dp = p.alignedDisparities;
+    const short invalid = static_cast<short>((p.minDisparity - 1) * cv::StereoMatcher::DISP_SCALE);
+
+#ifdef SGM_X86
+    const bool avx2 = hasAVX2();
+#endif
+
+    std::vector<int> best(w, -1);
+    std::vector<int> minRight(w, std::numeric_limits<int>::max());
+    std::vector<int> bestRight(w, -1);
+
+    for (int x = 0; x < w; ++x)
+    {
+        const ushort* s = sum + static_cast<size_t>(x) * Dp;
+        int minS = 0;
+        int d = 0;
+        bool unique = true;
+        int limit = -1;
+#ifdef SGM_X86
+        if (avx2)
+        {
+            findMinAVX2(s, D, minS, d);
+        }
+        else
+#endif
+        {
+            findMinScalar(s, D, minS, d);
+        }
+
+        //other disparity is rejected if sum*(100 - ratio) < minS*100
+        if (p.uniquenessRatio > 0 && minS > 0)
+        {
+            limit = (minS * 100 - 1) / (100 - p.uniquenessRatio);
+#ifdef SGM_X86
+            if (avx2)
+            {
+                unique = isUniqueAVX2(s, D, d, limit);
+            }
+            else
+#endif
+            {
+                unique = isUniqueScalar(s, D, d, limit);
+            }
+        }
+
+        if (!unique)
+        {
+            out[x] = invalid;
+            continue;
+        }
+
+        best[x] = d;
+        const int xr = x - p.minDisparity - d;
+        if (xr >= 0 && xr < w && minS < minRight[xr])
+        {
+            minRight[xr] = minS;
+            bestRight[xr] = d;
+        }
+
+        int d16 = d * cv::StereoMatcher::DISP_SCALE;
+        if (d > 0 && d < D - 1)
+        {
+            const int denom2 = std::max(s[d - 1] + s[d + 1] - 2 * s[d], 1);
+            d16 += ((s[d - 1] - s[d + 1]) * cv::StereoMatcher::DISP_SCALE + denom2) / (denom2 * 2);
+        }
+        out[x] = static_cast<short>(p.minDisparity * cv::StereoMatcher::DISP_SCALE + d16);
+    }
+
+    //left-right consistency, right disparities are taken from the same aggregated costs
+    if (p.disp12MaxDiff >= 0)
+    {
+        for (int x = 0; x < w; ++x)
+        {
+            if (best[x] < 0)
+            {
+                continue;
+            }
+            const int xr = x - p.minDisparity - best[x];
+            if (xr >= 0 && xr < w && bestRight[xr] >= 0 && std::abs(bestRight[xr] - best[x]) > p.disp12MaxDiff)
+            {
+                out[x] = invalid;
+            }
+        }
+    }
+}
+
+}
+
+cv::Ptr<SgmStereoMatcher> SgmStereoMatcher::create(int minDisparity, int numDisparities, int P1, int P2,
+                                                   int disp12MaxDiff, int uniquenessRatio,
+                                                   int speckleWindowSize, int speckleRange)
+{
+    return cv::makePtr<SgmStereoMatcher>(minDisparity, numDisparities, P1, P2,
+                                         disp12MaxDiff, uniquenessRatio,
+                                         speckleWindowSize, speckleRange);
+}
+
+SgmStereoMatcher::SgmStereoMatcher(int minDisparity, int numDisparities, int P1, int P2,
+                                   int disp12MaxDiff, int uniquenessRatio,
+                                   int speckleWindowSize, int speckleRange)
+    : minDisparity(minDisparity)
+    , numDisparities(numDisparities)
+    , blockSize(5)
+    , P1(P1)
+    , P2(P2)
+    , disp12MaxDiff(disp12MaxDiff)
+    , preFilterCap(0)
+    , uniquenessRatio(uniquenessRatio)
+    , speckleWindowSize(speckleWindowSize)
+    , speckleRange(speckleRange)
+    , bandsCount(0)
+{
+}
+
+void SgmStereoMatcher::compute(cv::InputArray leftArr, cv::InputArray rightArr, cv::OutputArray dispArr)
+{
+    cv::Mat left = leftArr.getMat();
+    cv::Mat right = rightArr.getMat();
+
+    CV_Assert(left.size() == right.size() && left.type() == right.type() && left.depth() == CV_8U);
+    CV_Assert(numDisparities > 0 && numDisparities % 16 == 0);
+
+    if (left.channels() == 3)
+    {
+        cv::Mat leftGray, rightGray;
+        cv::cvtColor(left, leftGray, CV_BGR2GRAY);
+        cv::cvtColor(right, rightGray, CV_BGR2GRAY);
+        left = leftGray;
+        right = rightGray;
+    }
+
+    SgmParams params;
+    params.width = left.cols;
+    params.height = left.rows;
+    params.minDisparity = minDisparity;
+    params.numDisparities = numDisparities;
+    params.alignedDisparities = (numDisparities + 31) & ~31;
+    params.P1 = std::min(std::max(P1, 0), maxP2);
+    params.P2 = std::min(std::max(P2, params.P1), maxP2);
+    params.uniquenessRatio = std::min(std::max(uniquenessRatio, 0), 99);
+    params.disp12MaxDiff = disp12MaxDiff;
+
+    censusTransform(left, leftCensus);
+    censusTransform(right, rightCensus);
+
+    dispArr.create(left.size(), CV_16S);
+    cv::Mat disp = dispArr.getMat();
+
+    int count = bandsCount > 0 ? bandsCount : std::min(params.height / defaultBandRows, maxDefaultBands);
+    count = std::max(1, std::min(count, params.height / bandWarmUpRows));
+    std::vector<cv::Range> bands;
+    for (int i = 0; i < count; ++i)
+    {
+        bands.push_back(cv::Range(params.height * i / count, params.height * (i + 1) / count));
+    }
+    cv::parallel_for_(cv::Range(0, count), SgmBandBody(params, leftCensus, rightCensus, bands, disp));
+
+    if (speckleWindowSize > 0)
+    {
+        cv::filterSpeckles(disp, (minDisparity - 1) * cv::StereoMatcher::DISP_SCALE, speckleWindowSize,
+                           cv::StereoMatcher::DISP_SCALE * speckleRange, speckleBuffer);
+    }
+}
+
+int SgmStereoMatcher::getMinDisparity() const
+{
+    return minDisparity;
+}
+
+void SgmStereoMatcher::setMinDisparity(int minDisparity)
+{
+    this->minDisparity = minDisparity;
+}
+
+int SgmStereoMatcher::getNumDisparities() const
+{
+    return numDisparities;
+}
+
+void SgmStereoMatcher::setNumDisparities(int numDisparities)
+{
+    this->numDisparities = numDisparities;
+}
+
+int SgmStereoMatcher::getBlockSize() const
+{
+    return blockSize;
+}
+
+void SgmStereoMatcher::setBlockSize(int blockSize)
+{
+    this->blockSize = blockSize;
+}
+
+int SgmStereoMatcher::getSpeckleWindowSize() const
+{
+    return speckleWindowSize;
+}
+
+void SgmStereoMatcher::setSpeckleWindowSize(int speckleWindowSize)
+{
+    this->speckleWindowSize = speckleWindowSize;
+}
+
+int SgmStereoMatcher::getSpeckleRange() const
+{
+    return speckleRange;
+}
+
+void SgmStereoMatcher::setSpeckleRange(int speckleRange)
+{
+    this->speckleRange = speckleRange;
+}
+
+int SgmStereoMatcher::getDisp12MaxDiff() const
+{
+    return disp12MaxDiff;
+}
+
+void SgmStereoMatcher::setDisp12MaxDiff(int disp12MaxDiff)
+{
+    this->disp12MaxDiff = disp12MaxDiff;
+}
+
+int SgmStereoMatcher::getPreFilterCap() const
+{
+    return preFilterCap;
+}
+
+void SgmStereoMatcher::setPreFilterCap(int preFilterCap)
+{
+    this->preFilterCap = preFilterCap;
+}
+
+int SgmStereoMatcher::getUniquenessRatio() const
+{
+    return uniquenessRatio;
+}
+
+void SgmStereoMatcher::setUniquenessRatio(int uniquenessRatio)
+{
+    this->uniquenessRatio = uniquenessRatio;
+}
+
+int SgmStereoMatcher::getP1() const
+{
+    return P1;
+}
+
+void SgmStereoMatcher::setP1(int P1)
+{
+    this->P1 = P1;
+}
+
+int SgmStereoMatcher::getP2() const
+{
+    return P2;
+}
+
+void SgmStereoMatcher::setP2(int P2)
+{
+    this->P2 = P2;
+}
+
+int SgmStereoMatcher::getMode() const
+{
+    return MODE_CENSUS;
+}
+
+void SgmStereoMatcher::setMode(int)
+{
+}
+
+int SgmStereoMatcher::getBandsCount() const
+{
+    return bandsCount;
+}
+
+void SgmStereoMatcher::setBandsCount(int count)
+{
+    bandsCount = count;
+}
@@ -0,0 +1,95 @@
+#ifndef SGMSTEREOMATCHER_H
+#define SGMSTEREOMATCHER_H
+
+#include <opencv2/opencv.hpp>
+
+//semi-global matching on 5x5 census cost, 5 paths aggregated in one top-down pass,
+//implements StereoSGBM interface so it can replace OpenCV matcher in DepthMapBuilder
+class SgmStereoMatcher : public cv::StereoSGBM
+{
+public:
+    //value returned by getMode, next after OpenCV SGBM modes
+    enum { MODE_CENSUS = 4 };
+
+    static cv::Ptr<SgmStereoMatcher> create(int minDisparity = 0, int numDisparities = 96,
+                                            int P1 = defaultP1, int P2 = defaultP2,
+                                            int disp12MaxDiff = 1, int uniquenessRatio = 10,
+                                            int speckleWindowSize = 100, int speckleRange = 32);
+
+    //penalties are in census cost units (0..24 per pixel)
+    static const int defaultP1 = 8;
+    static const int defaultP2 = 96;
+    static const int maxP2 = 200;
+
+    SgmStereoMatcher(int minDisparity, int numDisparities, int P1, int P2,
+                     int disp12MaxDiff, int uniquenessRatio,
+                     int speckleWindowSize, int speckleRange);
+
+    void compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) override;
+
+    int getMinDisparity() const override;
+    void setMinDisparity(int minDisparity) override;
+
+    int getNumDisparities() const override;
+    void setNumDisparities(int numDisparities) override;
+
+    //census window is fixed, block size is kept only for valid area computations
+    int getBlockSize() const override;
+    void setBlockSize(int blockSize) override;
+
+    int getSpeckleWindowSize() const override;
+    void setSpeckleWindowSize(int speckleWindowSize) override;
+
+    int getSpeckleRange() const override;
+    void setSpeckleRange(int speckleRange) override;
+
+    int getDisp12MaxDiff() const override;
+    void setDisp12MaxDiff(int disp12MaxDiff) override;
+
+    //census cost doesn't need prefilter, value is kept for compatibility
+    int getPreFilterCap() const override;
+    void setPreFilterCap(int preFilterCap) override;
+
+    int getUniquenessRatio() const override;
+    void setUniquenessRatio(int uniquenessRatio) override;
+
+    int getP1() const override;
+    void setP1(int P1) override;
+
+    int getP2() const override;
+    void setP2(int P2) override;
+
+    int getMode() const override;
+    void setMode(int mode) override;
+
+    //number of row bands processed in parallel, 0 - derived from image height only,
+    //so result does not depend on number of threads
+    int getBandsCount() const;
+    void setBandsCount(int count);
+
+    //rows per band and bands limit used when bands count is 0
+    static const int defaultBandRows = 64;
+    static const int maxDefaultBands = 16;
+
+    //rows processed before each band to let vertical paths converge
+    static const int bandWarmUpRows = 32;
+
+private:
+    int minDisparity;
+    int numDisparities;
+    int blockSize;
+    int P1;
+    int P2;
+    int disp12MaxDiff;
+    int preFilterCap;
+    int uniquenessRatio;
+    int speckleWindowSize;
+    int speckleRange;
+    int bandsCount;
+
+    cv::Mat leftCensus[3];
+    cv::Mat rightCensus[3];
+    cv::Mat speckleBuffer;
+};
+
+#endif // SGMSTEREOMATCHER_H
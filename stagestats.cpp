@@ -0,0 +1,272 @@
+#include "stagestats.h"
+#include "pipelinetrace.h"
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+//written only by owner thread, so relaxed load and store are enough
+struct ThreadHistograms
+{
+    ThreadHistograms()
+    {
+        for (int s = 0; s < StageStatistics::STAGES_COUNT; ++s)
+        {
+            count[s] = 0;
+            sum[s] = 0;
+            max[s] = 0;
+            for (int b = 0; b < StageStatistics::bucketsCount; ++b)
+            {
+                buckets[s][b] = 0;
+            }
+        }
+    }
+
+    std::atomic<unsigned long long> count[StageStatistics::STAGES_COUNT];
+    std::atomic<unsigned long long> sum[StageStatistics::STAGES_COUNT];
+    std::atomic<unsigned long long> max[StageStatistics::STAGES_COUNT];
+    std::atomic<unsigned long long> buckets[StageStatistics::STAGES_COUNT][StageStatistics::bucketsCount];
+};
+
+//histograms of finished threads are kept, so totals never decrease
+struct Registry
+{
+    std::mutex guard;
+    std::vector<std::shared_ptr<ThreadHistograms>> threads;
+    Clock::time_point start = Clock::now();
+};
+
+Registry& registry()
+{
+    static Registry instance;
+    return instance;
+}
+
+ThreadHistograms& threadHistograms()
+{
+    thread_local std::shared_ptr<ThreadHistograms> local;
+    if (!local)
+    {
+        local = std::make_shared<ThreadHistograms>();
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.guard);
+        r.threads.push_back(local);
+    }
+    return *local;
+}
+
+void increment(std::atomic<unsigned long long>& value, unsigned long long delta)
+{
+    value.store(value.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+int bucketIndex(unsigned long long us)
+{
+    us = std::min<unsigned long long>(us, 0xffffffffULL);
+    if (us < 4)
+    {
+        return static_cast<int>(us);
+    }
+    int msb = 2;
+    while ((us >> (msb + 1)) != 0)
+    {
+        ++msb;
+    }
+    int sub = static_cast<int>((us >> (msb - 2)) & 3);
+    return (msb - 1) * 4 + sub;
+}
+
+const char* const stageNames[StageStatistics::STAGES_COUNT] =
+{
+    "capture",
+    "decode",
+    "rectify",
+    "color",
+    "noise_filter",
+    "match",
+    "reproject",
+    "qt_convert"
+};
+
+}
+
+StageStatistics::Histogram::Histogram()
+    : count(0)
+    , sum(0)
+    , max(0)
+    , buckets(bucketsCount, 0)
+{
+}
+
+double StageStatistics::Histogram::mean() const
+{
+    return count > 0 ? static_cast<double>(sum) / count : 0;
+}
+
+double StageStatistics::Histogram::percentile(double p) const
+{
+    if (count == 0)
+    {
+        return 0;
+    }
+    const double rank = p / 100. * count;
+    unsigned long long seen = 0;
+    for (int b = 0; b < bucketsCount; ++b)
+    {
+        seen += buckets[b];
+        if (seen >= rank && buckets[b] > 0)
+        {
+            const double middle = 0.5 * (getBucketBound(b) + getBucketBound(b + 1));
+            return std::min(middle, static_cast<double>(max));
+        }
+    }
+    return static_cast<double>(max);
+}
+
+StageStatistics::Snapshot::Snapshot()
+    : seconds(0)
+{
+}
+
+void StageStatistics::record(Stage stage, unsigned long long us)
+{
+    ThreadHistograms& h = threadHistograms();
+    increment(h.count[stage], 1);
+    increment(h.sum[stage], us);
+    increment(h.buckets[stage][bucketIndex(us)], 1);
+    if (us > h.max[stage].load(std::memory_order_relaxed))
+    {
+        h.max[stage].store(us, std::memory_order_relaxed);
+    }
+}
+
+StageStatistics::Snapshot StageStatistics::getSnapshot()
+{
+    Snapshot snapshot;
+    std::vector<std::shared_ptr<ThreadHistograms>> threads;
+    {
+        Registry& r = registry();
+        std::unique_lock<std::mutex> lock(r.guard);
+        threads = r.threads;
+        snapshot.seconds = std::chrono::duration<double>(Clock::now() - r.start).count();
+    }
+
+    for (const auto& thread : threads)
+    {
+        for (int s = 0; s < STAGES_COUNT; ++s)
+        {
+            Histogram& h = snapshot.stages[s];
+            h.count += thread->count[s].load(std::memory_order_relaxed);
+            h.sum += thread->sum[s].load(std::memory_order_relaxed);
+            h.max = std::max(h.max, thread->max[s].load(std::memory_order_relaxed));
+            for (int b = 0; b < bucketsCount; ++b)
+            {
+                h.buckets[b] += thread->buckets[s][b].load(std::memory_order_relaxed);
+            }
+        }
+    }
+    return snapshot;
+}
+
+StageStatistics::Snapshot StageStatistics::difference(const Snapshot &later, const Snapshot &earlier)
+{
+    Snapshot snapshot;
+    snapshot.seconds = later.seconds - earlier.seconds;
+    for (int s = 0; s < STAGES_COUNT; ++s)
+    {
+        const Histogram& a = later.stages[s];
+        const Histogram& b = earlier.stages[s];
+        Histogram& h = snapshot.stages[s];
+        //counters of one thread may be read in different order, so keep differences non negative
+        h.count = a.count > b.count ? a.count - b.count : 0;
+        h.sum = a.sum > b.sum ? a.sum - b.sum : 0;
+        int top = -1;
+        for (int i = 0; i < bucketsCount; ++i)
+        {
+            h.buckets[i] = a.buckets[i] > b.buckets[i] ? a.buckets[i] - b.buckets[i] : 0;
+            if (h.buckets[i] > 0)
+            {
+                top = i;
+            }
+        }
+        h.max = top < 0 ? 0 : std::min(a.max, getBucketBound(top + 1));
+    }
+    return snapshot;
+}
+
+const char* StageStatistics::getStageName(Stage stage)
+{
+    return stage >= 0 && stage < STAGES_COUNT ? stageNames[stage] : "";
+}
+
+unsigned long long StageStatistics::getBucketBound(int bucket)
+{
+    if (bucket < 4)
+    {
+        return static_cast<unsigned long long>(std::max(bucket, 0));
+    }
+    const int msb = bucket / 4 + 1;
+    return static_cast<unsigned long long>(4 + bucket % 4) << (msb - 2);
+}
+
+std::string StageStatistics::toJson(const Snapshot &snapshot)
+{
+    std::ostringstream out;
+    out << "{\n  \"seconds\": " << snapshot.seconds << ",\n  \"stages\": {";
+    for (int s = 0; s < STAGES_COUNT; ++s)
+    {
+        const Histogram& h = snapshot.stages[s];
+        out << (s == 0 ? "\n" : ",\n")
+            << "    \"" << stageNames[s] << "\": {"
+            << "\"count\": " << h.count
+            << ", \"per_second\": " << (snapshot.seconds > 0 ? h.count / snapshot.seconds : 0)
+            << ", \"mean_us\": " << h.mean()
+            << ", \"p50_us\": " << h.percentile(50)
+            << ", \"p95_us\": " << h.percentile(95)
+            << ", \"p99_us\": " << h.percentile(99)
+            << ", \"max_us\": " << h.max
+            << ", \"buckets\": [";
+        //only non empty buckets as [lower bound us, count]
+        bool first = true;
+        for (int b = 0; b < bucketsCount; ++b)
+        {
+            if (h.buckets[b] > 0)
+            {
+                out << (first ? "" : ", ") << "[" << getBucketBound(b) << ", " << h.buckets[b] << "]";
+                first = false;
+            }
+        }
+        out << "]}";
+    }
+    out << "\n  }\n}\n";
+    return out.str();
+}
+
+bool StageStatistics::dumpJson(const std::string &fileName)
+{
+    std::ofstream file(fileName);
+    file << toJson(getSnapshot());
+    return static_cast<bool>(file);
+}
+
+ScopedStageTimer::ScopedStageTimer(StageStatistics::Stage stage)
+    : stage(stage)
+    , start(std::chrono::steady_clock::now())
+{
+}
+
+ScopedStageTimer::~ScopedStageTimer()
+{
+    const auto end = std::chrono::steady_clock::now();
+    PipelineTrace::record(StageStatistics::getStageName(stage), start, end);
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+    StageStatistics::record(stage, static_cast<unsigned long long>(std::max<long long>(us, 0)));
+}
@@ -0,0 +1,87 @@
+#ifndef STAGESTATS_H
+#define STAGESTATS_H
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+//latency histograms of pipeline stages, each thread records into its own histograms without locks,
+//readers sum all threads
+class StageStatistics
+{
+public:
+    enum Stage
+    {
+        STAGE_CAPTURE,      //waiting for filled driver buffer
+        STAGE_DECODE,       //MJPEG decoding
+        STAGE_RECTIFY,      //rectification or undistortion
+        STAGE_COLOR,        //colour conversion
+        STAGE_NOISE_FILTER,
+        STAGE_MATCH,        //stereo matching including WLS filter
+        STAGE_REPROJECT,
+        STAGE_QT_CONVERT,   //frame to QImage
+        STAGES_COUNT
+    };
+
+    //4 buckets per power of two, up to 2^32 us
+    static const int bucketsCount = 124;
+
+    struct Histogram
+    {
+        Histogram();
+
+        double mean() const;
+
+        //us, middle of bucket containing the percentile
+        double percentile(double p) const;
+
+        unsigned long long count;
+        unsigned long long sum; //us
+        unsigned long long max; //us
+        std::vector<unsigned long long> buckets;
+    };
+
+    struct Snapshot
+    {
+        Snapshot();
+
+        double seconds; //covered time
+        Histogram stages[STAGES_COUNT];
+    };
+
+    static void record(Stage stage, unsigned long long us);
+
+    //totals since start of application
+    static Snapshot getSnapshot();
+
+    //statistics of interval between two snapshots, max is limited by bucket bound
+    static Snapshot difference(const Snapshot& later, const Snapshot& earlier);
+
+    static const char* getStageName(Stage stage);
+
+    //lower bound of bucket, us
+    static unsigned long long getBucketBound(int bucket);
+
+    static std::string toJson(const Snapshot& snapshot);
+
+    static bool dumpJson(const std::string& fileName);
+};
+
+//records lifetime of the scope as stage latency, also as trace event when tracing is enabled
+class ScopedStageTimer
+{
+public:
+    explicit ScopedStageTimer(StageStatistics::Stage stage);
+
+    ~ScopedStageTimer();
+
+    ScopedStageTimer(const ScopedStageTimer&) = delete;
+
+    ScopedStageTimer& operator=(const ScopedStageTimer&) = delete;
+
+private:
+    StageStatistics::Stage stage;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // STAGESTATS_H
@@ -0,0 +1,166 @@
+#include "stereosynchronizer.h"
+
+#include <algorithm>
+
+StereoSynchronizer::Statistics::Statistics()
+    : pairs(0)
+    , rejectedLeft(0)
+    , rejectedRight(0)
+    , meanSkew(0)
+    , maxSkew(0)
+{
+}
+
+StereoSynchronizer::StereoSynchronizer(unsigned long long tolerance, size_t queueSize)
+    : tolerance(tolerance)
+    , queueSize(std::max<size_t>(queueSize, 1))
+    , hasLastLeft(false)
+    , hasLastRight(false)
+    , pairs(0)
+    , rejectedLeft(0)
+    , rejectedRight(0)
+    , skewSum(0)
+    , skewMax(0)
+{
+}
+
+void StereoSynchronizer::setTolerance(unsigned long long tolerance)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    this->tolerance = tolerance;
+}
+
+unsigned long long StereoSynchronizer::getTolerance() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return tolerance;
+}
+
+bool StereoSynchronizer::push(std::deque<Item>& queue, FrameInfo& lastInfo, bool& hasLast, unsigned long long& rejected,
+                              const FramePtr& frame, const FramePtr& gray, const FrameInfo& info)
+{
+    if (!frame || frame->empty())
+    {
+        return false;
+    }
+
+    if (hasLast && lastInfo.sequence == info.sequence && lastInfo.timestamp == info.timestamp)
+    {
+        return false;
+    }
+    lastInfo = info;
+    hasLast = true;
+
+    if (queue.size() >= queueSize)
+    {
+        queue.pop_front();
+        ++rejected;
+    }
+
+    Item item;
+    item.frame = frame;
+    item.gray = gray;
+    item.info = info;
+    queue.push_back(item);
+    return true;
+}
+
+bool StereoSynchronizer::pushLeft(const FramePtr& frame, const FrameInfo& info)
+{
+    return pushLeft(frame, FramePtr(), info);
+}
+
+bool StereoSynchronizer::pushRight(const FramePtr& frame, const FrameInfo& info)
+{
+    return pushRight(frame, FramePtr(), info);
+}
+
+bool StereoSynchronizer::pushLeft(const FramePtr& frame, const FramePtr& gray, const FrameInfo& info)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return push(leftQueue, lastLeft, hasLastLeft, rejectedLeft, frame, gray, info);
+}
+
+bool StereoSynchronizer::pushRight(const FramePtr& frame, const FramePtr& gray, const FrameInfo& info)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return push(rightQueue, lastRight, hasLastRight, rejectedRight, frame, gray, info);
+}
+
+bool StereoSynchronizer::getPair(FramePtr& left, FramePtr& right, FrameInfo& leftInfo, FrameInfo& rightInfo)
+{
+    FramePtr leftGray;
+    FramePtr rightGray;
+    return getPair(left, right, leftGray, rightGray, leftInfo, rightInfo);
+}
+
+bool StereoSynchronizer::getPair(FramePtr& left, FramePtr& right, FramePtr& leftGray, FramePtr& rightGray,
+                                 FrameInfo& leftInfo, FrameInfo& rightInfo)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    while (!leftQueue.empty() && !rightQueue.empty())
+    {
+        const Item& l = leftQueue.front();
+        const Item& r = rightQueue.front();
+
+        unsigned long long skew = l.info.timestamp > r.info.timestamp ?
+                                  l.info.timestamp - r.info.timestamp :
+                                  r.info.timestamp - l.info.timestamp;
+        if (skew <= tolerance)
+        {
+            left = l.frame;
+            right = r.frame;
+            leftGray = l.gray;
+            rightGray = r.gray;
+            leftInfo = l.info;
+            rightInfo = r.info;
+            leftQueue.pop_front();
+            rightQueue.pop_front();
+
+            double skewMs = skew / 1000.;
+            ++pairs;
+            skewSum += skewMs;
+            skewMax = std::max(skewMax, skewMs);
+            return true;
+        }
+
+        //older frame can't have a pair anymore, because next frames from other camera are even newer
+        if (l.info.timestamp < r.info.timestamp)
+        {
+            leftQueue.pop_front();
+            ++rejectedLeft;
+        }
+        else
+        {
+            rightQueue.pop_front();
+            ++rejectedRight;
+        }
+    }
+    return false;
+}
+
+void StereoSynchronizer::reset()
+{
+    std::unique_lock<std::mutex> lock(guard);
+    leftQueue.clear();
+    rightQueue.clear();
+    hasLastLeft = false;
+    hasLastRight = false;
+    pairs = 0;
+    rejectedLeft = 0;
+    rejectedRight = 0;
+    skewSum = 0;
+    skewMax = 0;
+}
+
+StereoSynchronizer::Statistics StereoSynchronizer::getStatistics() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    Statistics stat;
+    stat.pairs = pairs;
+    stat.rejectedLeft = rejectedLeft;
+    stat.rejectedRight = rejectedRight;
+    stat.meanSkew = pairs > 0 ? skewSum / pairs : 0;
+    stat.maxSkew = skewMax;
+    return stat;
+}
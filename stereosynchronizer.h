@@ -0,0 +1,87 @@
+#ifndef STEREOSYNCHRONIZER_H
+#define STEREOSYNCHRONIZER_H
+
+#include "framesource.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <deque>
+#include <mutex>
+
+//pairs left and right frames by capture timestamps
+class StereoSynchronizer
+{
+public:
+    struct Statistics
+    {
+        Statistics();
+
+        unsigned long long pairs;
+        unsigned long long rejectedLeft;
+        unsigned long long rejectedRight;
+        double meanSkew; //ms
+        double maxSkew; //ms
+    };
+
+    explicit StereoSynchronizer(unsigned long long tolerance = 10000, size_t queueSize = 4);
+
+    StereoSynchronizer(const StereoSynchronizer&) = delete;
+
+    StereoSynchronizer& operator=(const StereoSynchronizer&) = delete;
+
+    //tolerance in microseconds
+    void setTolerance(unsigned long long tolerance);
+
+    unsigned long long getTolerance() const;
+
+    //returns false if frame was already pushed
+    bool pushLeft(const FramePtr& frame, const FrameInfo& info);
+
+    bool pushRight(const FramePtr& frame, const FrameInfo& info);
+
+    //gray is optional gray version of the same frame, it is paired together with frame
+    bool pushLeft(const FramePtr& frame, const FramePtr& gray, const FrameInfo& info);
+
+    bool pushRight(const FramePtr& frame, const FramePtr& gray, const FrameInfo& info);
+
+    bool getPair(FramePtr& left, FramePtr& right, FrameInfo& leftInfo, FrameInfo& rightInfo);
+
+    bool getPair(FramePtr& left, FramePtr& right, FramePtr& leftGray, FramePtr& rightGray,
+                 FrameInfo& leftInfo, FrameInfo& rightInfo);
+
+    void reset();
+
+    Statistics getStatistics() const;
+
+private:
+    struct Item
+    {
+        FramePtr frame;
+        FramePtr gray;
+        FrameInfo info;
+    };
+
+    bool push(std::deque<Item>& queue, FrameInfo& lastInfo, bool& hasLast, unsigned long long& rejected,
+              const FramePtr& frame, const FramePtr& gray, const FrameInfo& info);
+
+private:
+    mutable std::mutex guard;
+
+    unsigned long long tolerance;
+    size_t queueSize;
+
+    std::deque<Item> leftQueue;
+    std::deque<Item> rightQueue;
+    FrameInfo lastLeft;
+    FrameInfo lastRight;
+    bool hasLastLeft;
+    bool hasLastRight;
+
+    unsigned long long pairs;
+    unsigned long long rejectedLeft;
+    unsigned long long rejectedRight;
+    double skewSum;
+    double skewMax;
+};
+
+#endif // STEREOSYNCHRONIZER_H
@@ -0,0 +1,207 @@
+#include "streamplayer.h"
+#include "stagestats.h"
+#include "pipelinetrace.h"
+
+#include <chrono>
+#include <iostream>
+
+namespace
+{
+    //next pass continues one mean frame interval after last frame
+    unsigned long long getPassDuration(const StreamReader& reader)
+    {
+        const size_t count = reader.getFramesCount();
+        if (count == 0)
+        {
+            return 0;
+        }
+        const unsigned long long first = reader.getRecord(0).info.timestamp;
+        const unsigned long long last = reader.getRecord(count - 1).info.timestamp;
+        return last - first + (count > 1 ? (last - first) / (count - 1) : 0);
+    }
+}
+
+StreamPlayer::StreamPlayer()
+    : speed(SPEED_NATIVE)
+    , fixedFps(30)
+    , loop(false)
+    , passDuration(0)
+    , stop(false)
+    , finished(false)
+    , playedFrames(0)
+{
+}
+
+StreamPlayer::~StreamPlayer()
+{
+    stopReplay();
+}
+
+void StreamPlayer::setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func)
+{
+    std::unique_lock<std::mutex> lock(callbackGuard);
+    frameCallback = func;
+}
+
+void StreamPlayer::setSpeed(Speed speed, double fps)
+{
+    this->speed = speed;
+    fixedFps = fps > 0 ? fps : 30;
+}
+
+void StreamPlayer::setLoop(bool loop)
+{
+    this->loop = loop;
+}
+
+void StreamPlayer::setPassDuration(unsigned long long duration)
+{
+    passDuration = duration;
+}
+
+unsigned long long StreamPlayer::getPassDuration(const std::string &fileName)
+{
+    StreamReader reader;
+    return reader.open(fileName) ? ::getPassDuration(reader) : 0;
+}
+
+bool StreamPlayer::startReplay(const std::string &fileName)
+{
+    stopReplay();
+
+    if (!reader.open(fileName) || reader.getFramesCount() == 0)
+    {
+        reader.close();
+        return false;
+    }
+
+    stop = false;
+    finished = false;
+    playedFrames = 0;
+    thread = std::thread(&StreamPlayer::replaying, this);
+    return true;
+}
+
+void StreamPlayer::stopReplay()
+{
+    stop = true;
+    if (thread.joinable())
+    {
+        thread.join();
+    }
+    reader.close();
+}
+
+bool StreamPlayer::isFinished() const
+{
+    return finished;
+}
+
+bool StreamPlayer::isReplaying() const
+{
+    return thread.joinable() && !stop;
+}
+
+void StreamPlayer::getFrame(FramePtr &frame, FrameInfo &info)
+{
+    std::unique_lock<std::mutex> lock(outGuard);
+    frame = outFrame;
+    info = outFrameInfo;
+}
+
+unsigned long long StreamPlayer::getPlayedFrames() const
+{
+    return playedFrames;
+}
+
+double StreamPlayer::getCpuUsage()
+{
+    return cpuUsage.getUsage();
+}
+
+FramePool::Statistics StreamPlayer::getPoolStatistics() const
+{
+    return framePool.getStatistics();
+}
+
+void StreamPlayer::replaying()
+{
+    typedef std::chrono::steady_clock Clock;
+
+    const int width = reader.getWidth();
+    const int height = reader.getHeight();
+    framePool.reserve(height, width, CV_8UC3);
+
+    const unsigned long long firstTimestamp = reader.getRecord(0).info.timestamp;
+    const std::chrono::microseconds fixedInterval(static_cast<long long>(1000000 / fixedFps));
+    const unsigned long long pass = passDuration > 0 ? passDuration : ::getPassDuration(reader);
+    unsigned long long timestampOffset = 0;
+
+    cpuUsage.startThread();
+    PipelineTrace::setThreadName("replay");
+    const Clock::time_point start = Clock::now();
+    size_t index = 0;
+    unsigned long long played = 0;
+    while (!stop)
+    {
+        cpuUsage.update();
+        const StreamReader::Record& record = reader.getRecord(index);
+        FrameInfo info(record.info.timestamp + timestampOffset, record.info.sequence);
+
+        //frames are due relative to replay start, so decoding time does not accumulate as drift
+        if (speed == SPEED_NATIVE)
+        {
+            std::this_thread::sleep_until(start + std::chrono::microseconds(info.timestamp - firstTimestamp));
+        }
+        else if (speed == SPEED_FIXED)
+        {
+            std::this_thread::sleep_until(start + fixedInterval * played);
+        }
+
+        ScopedTraceEvent frameEvent("replay frame", info);
+        try
+        {
+            const cv::Mat rawData(1, static_cast<int>(record.size), CV_8UC1, const_cast<char*>(record.data));
+            //broken record is skipped before decoding, so previous content of pooled buffer is never published
+            std::shared_ptr<cv::Mat> frame;
+            if (isCompleteJpeg(record.data, record.size))
+            {
+                frame = framePool.acquire(height, width, CV_8UC3);
+                ScopedStageTimer timer(StageStatistics::STAGE_DECODE);
+                cv::imdecode(rawData, CV_LOAD_IMAGE_UNCHANGED, frame.get());
+            }
+            if (frame && !frame->empty())
+            {
+                {
+                    std::unique_lock<std::mutex> lock(outGuard);
+                    outFrame = frame;
+                    outFrameInfo = info;
+                }
+                notifyFrame();
+                {
+                    std::unique_lock<std::mutex> lock(callbackGuard);
+                    if (frameCallback)
+                    {
+                        frameCallback(frame, info);
+                    }
+                }
+                playedFrames = ++played;
+            }
+        }
+        catch(std::exception& err)
+        {
+            std::cerr << err.what() << std::endl;
+        }
+
+        if (++index == reader.getFramesCount())
+        {
+            if (!loop)
+            {
+                break;
+            }
+            index = 0;
+            timestampOffset += pass;
+        }
+    }
+    finished = !stop;
+}
@@ -0,0 +1,96 @@
+#ifndef STREAMPLAYER_H
+#define STREAMPLAYER_H
+
+#include "framesource.h"
+#include "recordedstream.h"
+#include "cpuusage.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+
+//replays recording made by Camera in place of it, frames keep recorded timestamps
+class StreamPlayer : public FrameSource
+{
+public:
+    enum Speed
+    {
+        SPEED_NATIVE, //recorded frame intervals
+        SPEED_FIXED,  //constant frame rate
+        SPEED_MAX     //as fast as frames are decoded
+    };
+
+    StreamPlayer();
+
+    ~StreamPlayer();
+
+    StreamPlayer(const StreamPlayer&) = delete;
+
+    StreamPlayer& operator=(const StreamPlayer&) = delete;
+
+    //called from replay thread, like Camera callback
+    void setFrameCallback(std::function<void (const FramePtr&, const FrameInfo&)> func);
+
+    //applied on next replay start, fps is used only by SPEED_FIXED
+    void setSpeed(Speed speed, double fps = 30);
+
+    //when looped timestamps keep growing, so synchronizer sees a continuous stream
+    void setLoop(bool loop);
+
+    //timestamps advance by this on each looped pass, us, players of one stereo recording should share it
+    //so their frames stay paired, 0 means duration of own recording
+    void setPassDuration(unsigned long long duration);
+
+    //span of recording plus one mean frame interval, us, 0 if recording can not be opened
+    static unsigned long long getPassDuration(const std::string& fileName);
+
+    bool startReplay(const std::string& fileName);
+
+    void stopReplay();
+
+    //last frame was played and replay is not looped
+    bool isFinished() const;
+
+    //replay was started and not stopped, finished replay still counts
+    bool isReplaying() const;
+
+    void getFrame(FramePtr& frame, FrameInfo& info) override;
+
+    unsigned long long getPlayedFrames() const;
+
+    double getCpuUsage();
+
+    FramePool::Statistics getPoolStatistics() const;
+
+private:
+
+    void replaying();
+
+private:
+
+    std::function<void (const FramePtr&, const FrameInfo&)> frameCallback;
+    std::mutex callbackGuard;
+
+    StreamReader reader;
+    Speed speed;
+    double fixedFps;
+    bool loop;
+    unsigned long long passDuration;
+
+    FramePtr outFrame;
+    FrameInfo outFrameInfo;
+    std::mutex outGuard;
+
+    std::thread thread;
+    std::atomic<bool> stop;
+    std::atomic<bool> finished;
+    std::atomic<unsigned long long> playedFrames;
+
+    CpuUsageCounter cpuUsage;
+    FramePool framePool;
+};
+
+#endif // STREAMPLAYER_H
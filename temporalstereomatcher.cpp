@@ -0,0 +1,247 @@
+#include "temporalstereomatcher.h"
+
+#include <algorithm>
+
+TemporalStereoMatcher::Statistics::Statistics()
+    : frames(0)
+    , keyFrames(0)
+    , lastReused(0)
+    , meanReused(0)
+{
+}
+
+cv::Ptr<TemporalStereoMatcher> TemporalStereoMatcher::create(const cv::Ptr<cv::StereoSGBM>& matcher)
+{
+    return cv::makePtr<TemporalStereoMatcher>(matcher);
+}
+
+TemporalStereoMatcher::TemporalStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher)
+    : matcher(matcher)
+    , tileSize(defaultTileSize)
+    , changeThreshold(defaultChangeThreshold)
+    , refreshInterval(defaultRefreshInterval)
+    , lastTileSize(0)
+    , framesToRefresh(0)
+    , resetRequested(false)
+{
+}
+
+void TemporalStereoMatcher::compute(cv::InputArray leftArr, cv::InputArray rightArr, cv::OutputArray dispArr)
+{
+    cv::Mat left = leftArr.getMat();
+    cv::Mat right = rightArr.getMat();
+    CV_Assert(left.size() == right.size() && left.type() == right.type() && left.depth() == CV_8U);
+
+    cv::Ptr<cv::StereoSGBM> current;
+    int size = 0;
+    int threshold = 0;
+    int interval = 0;
+    bool resetHistory = false;
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        current = matcher;
+        size = tileSize;
+        threshold = changeThreshold;
+        interval = refreshInterval;
+        resetHistory = resetRequested;
+        resetRequested = false;
+    }
+
+    const MatcherParams params(*current);
+    bool keyFrame = resetHistory
+            || current != lastMatcher
+            || lastDisp.empty()
+            || lastDisp.size() != left.size()
+            || referenceLeft.type() != left.type()
+            || params != lastParams
+            || size != lastTileSize
+            || framesToRefresh <= 0;
+
+    double reused = 0;
+    if (!keyFrame)
+    {
+        findChangedTiles(left, right, params, size, threshold);
+        keyFrame = cv::countNonZero(changed) > maxChangedShare * changed.total();
+    }
+
+    if (keyFrame)
+    {
+        current->compute(left, right, lastDisp);
+        left.copyTo(referenceLeft);
+        right.copyTo(referenceRight);
+        lastMatcher = current;
+        lastParams = params;
+        lastTileSize = size;
+        framesToRefresh = interval;
+    }
+    else
+    {
+        const size_t matched = matchChangedTiles(*current, left, right, params, size);
+        reused = 1. - static_cast<double>(matched) / left.total();
+        --framesToRefresh;
+    }
+    lastDisp.copyTo(dispArr);
+
+    std::unique_lock<std::mutex> lock(guard);
+    ++statistics.frames;
+    statistics.keyFrames += keyFrame ? 1 : 0;
+    statistics.lastReused = reused;
+    statistics.meanReused += (reused - statistics.meanReused) / statistics.frames;
+}
+
+void TemporalStereoMatcher::findChangedTiles(const cv::Mat& left, const cv::Mat& right, const MatcherParams& params,
+                                             int tileSize, int threshold)
+{
+    const cv::Size tiles((left.cols + tileSize - 1) / tileSize, (left.rows + tileSize - 1) / tileSize);
+
+    cv::absdiff(left, referenceLeft, leftDiff);
+    cv::absdiff(right, referenceRight, rightDiff);
+    if (leftDiff.channels() == 3)
+    {
+        cv::cvtColor(leftDiff, leftDiff, CV_BGR2GRAY);
+        cv::cvtColor(rightDiff, rightDiff, CV_BGR2GRAY);
+    }
+    cv::resize(leftDiff, leftMeans, tiles, 0, 0, cv::INTER_AREA);
+    cv::resize(rightDiff, rightMeans, tiles, 0, 0, cv::INTER_AREA);
+
+    cv::Mat leftChanged = leftMeans > threshold;
+    cv::Mat rightChanged = rightMeans > threshold;
+
+    //right pixel x is matched by left pixels x + d, so changed right tile affects tiles on its right
+    const int reach = (std::max(0, params.minDisparity + params.numDisparities) + tileSize - 1) / tileSize;
+    cv::dilate(rightChanged, rightChanged,
+               cv::getStructuringElement(cv::MORPH_RECT, cv::Size(reach + 1, 1), cv::Point(reach, 0)));
+
+    //neighbour tiles are matched too, so disparity at tile border is consistent
+    cv::bitwise_or(leftChanged, rightChanged, changed);
+    cv::dilate(changed, changed, cv::Mat());
+}
+
+size_t TemporalStereoMatcher::matchChangedTiles(cv::StereoSGBM& matcher, const cv::Mat& left, const cv::Mat& right,
+                                                const MatcherParams& params, int tileSize)
+{
+    const cv::Rect frame(0, 0, left.cols, left.rows);
+    const int reach = std::max(0, params.minDisparity + params.numDisparities);
+    const int margin = contextMargin + params.blockSize / 2;
+
+    size_t matched = 0;
+    cv::Mat cropDisp;
+    int ty = 0;
+    while (ty < changed.rows)
+    {
+        //consecutive tile rows with changes are matched as one region
+        int tx0 = changed.cols;
+        int tx1 = -1;
+        int ty1 = ty;
+        for (; ty1 < changed.rows; ++ty1)
+        {
+            const uchar* row = changed.ptr<uchar>(ty1);
+            const uchar* first = std::find_if(row, row + changed.cols, [](uchar v){ return v != 0; });
+            if (first == row + changed.cols)
+            {
+                break;
+            }
+            const uchar* last = row + changed.cols - 1;
+            while (*last == 0)
+            {
+                --last;
+            }
+            tx0 = std::min(tx0, static_cast<int>(first - row));
+            tx1 = std::max(tx1, static_cast<int>(last - row));
+        }
+        if (ty1 == ty)
+        {
+            ++ty;
+            continue;
+        }
+
+        //leftmost columns of crop have no disparity, so crop starts disparity range earlier
+        const cv::Rect region(tx0 * tileSize, ty * tileSize, (tx1 - tx0 + 1) * tileSize, (ty1 - ty) * tileSize);
+        const cv::Rect crop = cv::Rect(region.x - reach - margin, region.y - margin,
+                                       region.width + reach + 2 * margin, region.height + 2 * margin) & frame;
+        matcher.compute(left(crop), right(crop), cropDisp);
+
+        for (int y = ty; y < ty1; ++y)
+        {
+            const uchar* row = changed.ptr<uchar>(y);
+            for (int x = tx0; x <= tx1; ++x)
+            {
+                if (row[x] == 0)
+                {
+                    continue;
+                }
+                const cv::Rect tile = cv::Rect(x * tileSize, y * tileSize, tileSize, tileSize) & frame;
+                cv::Mat dst = lastDisp(tile);
+                cropDisp(tile - crop.tl()).copyTo(dst);
+                dst = referenceLeft(tile);
+                left(tile).copyTo(dst);
+                dst = referenceRight(tile);
+                right(tile).copyTo(dst);
+                matched += tile.area();
+            }
+        }
+        ty = ty1;
+    }
+    return matched;
+}
+
+void TemporalStereoMatcher::setMatcher(const cv::Ptr<cv::StereoSGBM>& matcher)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    this->matcher = matcher;
+}
+
+cv::Ptr<cv::StereoSGBM> TemporalStereoMatcher::getMatcher() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return matcher;
+}
+
+int TemporalStereoMatcher::getTileSize() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return tileSize;
+}
+
+void TemporalStereoMatcher::setTileSize(int size)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    tileSize = std::max(size, 8);
+}
+
+int TemporalStereoMatcher::getChangeThreshold() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return changeThreshold;
+}
+
+void TemporalStereoMatcher::setChangeThreshold(int threshold)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    changeThreshold = std::max(threshold, 0);
+}
+
+int TemporalStereoMatcher::getRefreshInterval() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return refreshInterval;
+}
+
+void TemporalStereoMatcher::setRefreshInterval(int frames)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    refreshInterval = std::max(frames, 0);
+}
+
+TemporalStereoMatcher::Statistics TemporalStereoMatcher::getStatistics() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return statistics;
+}
+
+void TemporalStereoMatcher::reset()
+{
+    std::unique_lock<std::mutex> lock(guard);
+    resetRequested = true;
+    statistics = Statistics();
+}
@@ -0,0 +1,92 @@
+#ifndef TEMPORALSTEREOMATCHER_H
+#define TEMPORALSTEREOMATCHER_H
+
+#include "matcherparams.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <mutex>
+
+//reuses disparity of tiles which did not change since they were matched last time,
+//changed tiles with border are matched again by wrapped matcher on cropped pair
+class TemporalStereoMatcher : public WrappedStereoMatcher
+{
+public:
+    struct Statistics
+    {
+        Statistics();
+
+        unsigned long long frames;
+        unsigned long long keyFrames; //frames matched as a whole
+        double lastReused; //share of reused area in last frame
+        double meanReused;
+    };
+
+    static const int defaultTileSize = 32;
+    //mean absolute difference of tile pixels, gray levels
+    static const int defaultChangeThreshold = 6;
+    //frames between full matching, so slow drift and parameter changes are picked up
+    static const int defaultRefreshInterval = 30;
+    //rows and columns of context added to matched region besides disparity range
+    static const int contextMargin = 32;
+    //whole frame is matched if larger share of tiles changed
+    static constexpr double maxChangedShare = 0.5;
+
+    static cv::Ptr<TemporalStereoMatcher> create(const cv::Ptr<cv::StereoSGBM>& matcher);
+
+    explicit TemporalStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher);
+
+    //should be called from one thread at a time
+    void compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) override;
+
+    //history is dropped when other matcher is used
+    void setMatcher(const cv::Ptr<cv::StereoSGBM>& matcher);
+    cv::Ptr<cv::StereoSGBM> getMatcher() const override;
+
+    int getTileSize() const;
+    void setTileSize(int size);
+
+    int getChangeThreshold() const;
+    void setChangeThreshold(int threshold);
+
+    int getRefreshInterval() const;
+    void setRefreshInterval(int frames);
+
+    Statistics getStatistics() const;
+
+    void reset();
+
+private:
+    //tiles which differ from reference frames, including ones seen by changed right tiles
+    void findChangedTiles(const cv::Mat& left, const cv::Mat& right, const MatcherParams& params,
+                          int tileSize, int threshold);
+
+    //matches runs of tile rows with changes and copies result of changed tiles, returns matched area
+    size_t matchChangedTiles(cv::StereoSGBM& matcher, const cv::Mat& left, const cv::Mat& right,
+                             const MatcherParams& params, int tileSize);
+
+private:
+    cv::Ptr<cv::StereoSGBM> matcher;
+    int tileSize;
+    int changeThreshold;
+    int refreshInterval;
+
+    cv::Ptr<cv::StereoSGBM> lastMatcher;
+    MatcherParams lastParams;
+    int lastTileSize;
+    int framesToRefresh;
+    cv::Mat referenceLeft;
+    cv::Mat referenceRight;
+    cv::Mat lastDisp;
+    cv::Mat changed;
+    cv::Mat leftDiff;
+    cv::Mat rightDiff;
+    cv::Mat leftMeans;
+    cv::Mat rightMeans;
+
+    bool resetRequested;
+    Statistics statistics;
+    mutable std::mutex guard;
+};
+
+#endif // TEMPORALSTEREOMATCHER_H
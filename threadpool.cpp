@@ -0,0 +1,130 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(size_t threadsCount)
+    : queued(0)
+    , pending(0)
+    , stop(false)
+{
+    threadsCount = std::max<size_t>(threadsCount, 1);
+    for (size_t i = 0; i < threadsCount; ++i)
+    {
+        queues.emplace_back(new Queue());
+    }
+    for (size_t i = 0; i < threadsCount; ++i)
+    {
+        threads.emplace_back(&ThreadPool::working, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        stop = true;
+    }
+    taskArrived.notify_all();
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+size_t ThreadPool::size() const
+{
+    return threads.size();
+}
+
+void ThreadPool::run(const std::vector<Task>& tasks)
+{
+    if (tasks.empty())
+    {
+        return;
+    }
+
+    //tasks are referenced by queues, so only one batch can be in flight
+    std::unique_lock<std::mutex> runLock(runGuard);
+    std::unique_lock<std::mutex> lock(guard);
+    pending = tasks.size();
+    queued = tasks.size();
+    for (size_t i = 0; i < tasks.size(); ++i)
+    {
+        Queue& queue = *queues[i % queues.size()];
+        std::unique_lock<std::mutex> queueLock(queue.guard);
+        queue.tasks.push_back(&tasks[i]);
+    }
+    taskArrived.notify_all();
+    tasksDone.wait(lock, [this]{ return pending == 0; });
+
+    std::exception_ptr taskError;
+    std::swap(taskError, error);
+    if (taskError)
+    {
+        std::rethrow_exception(taskError);
+    }
+}
+
+void ThreadPool::working(size_t index)
+{
+    while (true)
+    {
+        const Task* task = nullptr;
+        if (popTask(index, task))
+        {
+            //exception leaving worker would terminate application
+            std::exception_ptr taskError;
+            try
+            {
+                (*task)(index);
+            }
+            catch(...)
+            {
+                taskError = std::current_exception();
+            }
+            std::unique_lock<std::mutex> lock(guard);
+            if (taskError && !error)
+            {
+                error = taskError;
+            }
+            if (--pending == 0)
+            {
+                tasksDone.notify_all();
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(guard);
+        taskArrived.wait(lock, [this]{ return stop || queued > 0; });
+        if (stop)
+        {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::popTask(size_t index, const Task*& task)
+{
+    for (size_t i = 0; i < queues.size(); ++i)
+    {
+        Queue& queue = *queues[(index + i) % queues.size()];
+        std::unique_lock<std::mutex> lock(queue.guard);
+        if (queue.tasks.empty())
+        {
+            continue;
+        }
+        if (i == 0)
+        {
+            task = queue.tasks.back();
+            queue.tasks.pop_back();
+        }
+        else
+        {
+            task = queue.tasks.front();
+            queue.tasks.pop_front();
+        }
+        --queued;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,61 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//fixed set of worker threads, each has its own task queue and idle workers steal tasks from others
+class ThreadPool
+{
+public:
+    //argument is index of worker which executes task, in range [0, size())
+    typedef std::function<void(size_t)> Task;
+
+    explicit ThreadPool(size_t threadsCount = std::thread::hardware_concurrency());
+
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    size_t size() const;
+
+    //spreads tasks over workers queues and waits until all of them are done,
+    //first exception thrown by tasks is rethrown after that
+    void run(const std::vector<Task>& tasks);
+
+private:
+    struct Queue
+    {
+        std::mutex guard;
+        std::deque<const Task*> tasks;
+    };
+
+    void working(size_t index);
+
+    //own queue is used from the back, others are robbed from the front
+    bool popTask(size_t index, const Task*& task);
+
+private:
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex runGuard;
+    std::mutex guard;
+    std::condition_variable taskArrived;
+    std::condition_variable tasksDone;
+    std::atomic<size_t> queued;
+    size_t pending;
+    std::exception_ptr error;
+    bool stop;
+};
+
+#endif // THREADPOOL_H
@@ -0,0 +1,122 @@
+#include "tiledstereomatcher.h"
+#include "sgmstereomatcher.h"
+
+#include <algorithm>
+
+cv::Ptr<TiledStereoMatcher> TiledStereoMatcher::create(const cv::Ptr<cv::StereoSGBM>& matcher, int bandsCount,
+                                                       size_t threadsCount)
+{
+    return cv::makePtr<TiledStereoMatcher>(matcher, bandsCount, threadsCount);
+}
+
+TiledStereoMatcher::TiledStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher, int bandsCount, size_t threadsCount)
+    : matcher(matcher)
+    , bandsCount(bandsCount)
+    , aggregationMargin(defaultAggregationMargin)
+    , pool(threadsCount)
+{
+}
+
+void TiledStereoMatcher::compute(cv::InputArray leftArr, cv::InputArray rightArr, cv::OutputArray dispArr)
+{
+    cv::Mat left = leftArr.getMat();
+    cv::Mat right = rightArr.getMat();
+    CV_Assert(left.size() == right.size() && left.type() == right.type());
+
+    int count = 1;
+    int margin = 0;
+    {
+        std::unique_lock<std::mutex> lock(guard);
+        count = bandsCount;
+        margin = aggregationMargin;
+        updateWorkers();
+    }
+
+    //band should be higher than its overlap, otherwise most of work is repeated
+    const int overlap = workersParams.blockSize / 2 + margin;
+    count = std::max(1, std::min(count, left.rows / std::max(overlap, 1)));
+
+    dispArr.create(left.size(), CV_16S);
+    cv::Mat disp = dispArr.getMat();
+
+    if (count == 1)
+    {
+        workers[0]->compute(left, right, disp);
+        return;
+    }
+
+    tasks.clear();
+    for (int i = 0; i < count; ++i)
+    {
+        const int y0 = left.rows * i / count;
+        const int y1 = left.rows * (i + 1) / count;
+        tasks.push_back([&, y0, y1](size_t worker)
+        {
+            const int top = std::max(0, y0 - overlap);
+            const int bottom = std::min(left.rows, y1 + overlap);
+            cv::Mat& bandDisp = bandDisparities[worker];
+            workers[worker]->compute(left.rowRange(top, bottom), right.rowRange(top, bottom), bandDisp);
+            cv::Mat dst = disp.rowRange(y0, y1);
+            bandDisp.rowRange(y0 - top, y1 - top).copyTo(dst);
+        });
+    }
+    pool.run(tasks);
+}
+
+cv::Ptr<cv::StereoSGBM> TiledStereoMatcher::getMatcher() const
+{
+    return matcher;
+}
+
+int TiledStereoMatcher::getBandsCount() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return bandsCount;
+}
+
+void TiledStereoMatcher::setBandsCount(int count)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    bandsCount = count;
+}
+
+int TiledStereoMatcher::getAggregationMargin() const
+{
+    std::unique_lock<std::mutex> lock(guard);
+    return aggregationMargin;
+}
+
+void TiledStereoMatcher::setAggregationMargin(int margin)
+{
+    std::unique_lock<std::mutex> lock(guard);
+    aggregationMargin = std::max(margin, 0);
+}
+
+size_t TiledStereoMatcher::getThreadsCount() const
+{
+    return pool.size();
+}
+
+void TiledStereoMatcher::updateWorkers()
+{
+    MatcherParams params(*matcher);
+    if (!workers.empty() && params == workersParams)
+    {
+        return;
+    }
+
+    workers.clear();
+    for (size_t i = 0; i < pool.size(); ++i)
+    {
+        cv::Ptr<cv::StereoSGBM> worker = params.createMatcher();
+        cv::Ptr<SgmStereoMatcher> census = worker.dynamicCast<SgmStereoMatcher>();
+        if (census)
+        {
+            //band is already processed by one thread
+            census->setBandsCount(1);
+        }
+        workers.push_back(worker);
+    }
+    bandDisparities.resize(pool.size());
+    workersParams = params;
+}
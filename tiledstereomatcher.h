@@ -0,0 +1,56 @@
+#ifndef TILEDSTEREOMATCHER_H
+#define TILEDSTEREOMATCHER_H
+
+#include "threadpool.h"
+#include "matcherparams.h"
+
+#include <opencv2/opencv.hpp>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//splits stereo pair into horizontal bands and matches them concurrently on thread pool,
+//parameters are taken from wrapped matcher, each worker uses its own copy of it
+class TiledStereoMatcher : public WrappedStereoMatcher
+{
+public:
+    //rows added to each side of band besides blockSize/2, so path aggregation has context
+    static const int defaultAggregationMargin = 32;
+
+    static cv::Ptr<TiledStereoMatcher> create(const cv::Ptr<cv::StereoSGBM>& matcher, int bandsCount,
+                                              size_t threadsCount = std::thread::hardware_concurrency());
+
+    TiledStereoMatcher(const cv::Ptr<cv::StereoSGBM>& matcher, int bandsCount, size_t threadsCount);
+
+    //should be called from one thread at a time
+    void compute(cv::InputArray left, cv::InputArray right, cv::OutputArray disparity) override;
+
+    cv::Ptr<cv::StereoSGBM> getMatcher() const override;
+
+    int getBandsCount() const;
+    void setBandsCount(int count);
+
+    int getAggregationMargin() const;
+    void setAggregationMargin(int margin);
+
+    size_t getThreadsCount() const;
+
+private:
+    //recreates workers matchers when parameters of wrapped one were changed
+    void updateWorkers();
+
+private:
+    cv::Ptr<cv::StereoSGBM> matcher;
+    int bandsCount;
+    int aggregationMargin;
+
+    ThreadPool pool;
+    MatcherParams workersParams;
+    std::vector<cv::Ptr<cv::StereoSGBM>> workers;
+    std::vector<cv::Mat> bandDisparities;
+    std::vector<ThreadPool::Task> tasks;
+    mutable std::mutex guard;
+};
+
+#endif // TILEDSTEREOMATCHER_H
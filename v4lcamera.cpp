@@ -3,6 +3,7 @@
 #include <stdexcept>
 #include <iostream>
 #include <sstream>
+#include <algorithm>
 
 #include <sys/types.h>
 #include <sys/ioctl.h>
@@ -21,11 +22,43 @@ namespace utils {
 
 const unsigned vide_type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
 
-V4LCamera::ScopedMMapBuffer::ScopedMMapBuffer()
+V4LCamera::ScopedMMapBuffer::ScopedMMapBuffer(int fd, unsigned index, const std::string& devName)
     : buffer(nullptr)
     , length(0)
 {
+    //get size of the reqired buffer
+    struct v4l2_buffer bufferinfo;
+    memset(&bufferinfo, 0, sizeof(bufferinfo));
+
+    bufferinfo.type = vide_type;
+    bufferinfo.memory = V4L2_MEMORY_MMAP;
+    bufferinfo.index = index;
+
+    if(ioctl(fd, VIDIOC_QUERYBUF, &bufferinfo) < 0)
+    {
+        throw std::runtime_error("Unable request size of memory buffers for device : " + devName);
+    }
+
+    //map memory
+    void* buffer_start = mmap(
+        NULL,
+        bufferinfo.length,
+        PROT_READ | PROT_WRITE,
+        MAP_SHARED,
+        fd,
+        bufferinfo.m.offset
+    );
 
+    if(buffer_start == MAP_FAILED)
+    {
+        throw std::runtime_error("Unable map memory buffers for device : " + devName);
+    }
+
+    buffer = buffer_start;
+    length = bufferinfo.length;
+
+    //clear memory
+    memset(buffer, 0, length);
 }
 
 V4LCamera::ScopedMMapBuffer::~ScopedMMapBuffer()
@@ -36,18 +69,16 @@ V4LCamera::ScopedMMapBuffer::~ScopedMMapBuffer()
     }
 }
 
-void V4LCamera::ScopedMMapBuffer::init(void* buf, size_t length)
-{
-    this->buffer = buf;
-    this->length  = length;
-}
-
-V4LCamera::V4LCamera(int devId, const VideoDevFormat &format)
+V4LCamera::V4LCamera(int devId, const VideoDevFormat &format, unsigned buffersCount)
     : device(devId)
     , capturing(false)
+    , hasSequence(false)
+    , lastSequence(0)
+    , droppedFrames(0)
 {
     //setup format
     struct v4l2_format v4lformat;
+    memset(&v4lformat, 0, sizeof(v4lformat));
     v4lformat.type = vide_type;
     v4lformat.fmt.pix.pixelformat = format.pixelformat;
     v4lformat.fmt.pix.width = format.width;
@@ -61,65 +92,74 @@ V4LCamera::V4LCamera(int devId, const VideoDevFormat &format)
 
     //memory buffers setup
     struct v4l2_requestbuffers bufrequest;
+    memset(&bufrequest, 0, sizeof(bufrequest));
     bufrequest.type = vide_type;
     bufrequest.memory = V4L2_MEMORY_MMAP;
-    bufrequest.count = 1;
+    bufrequest.count = buffersCount > 0 ? buffersCount : 1;
 
     if(ioctl(device.fd(), VIDIOC_REQBUFS, &bufrequest) < 0)
     {
         throw std::runtime_error("Unable request memory buffers for device : " + device.fileName());
     }
 
-    //get size of the reqired buffer
-    struct v4l2_buffer bufferinfo;
-    memset(&bufferinfo, 0, sizeof(bufferinfo));
-
-    bufferinfo.type = vide_type;
-    bufferinfo.memory = V4L2_MEMORY_MMAP;
-    bufferinfo.index = 0;
-
-    if(ioctl(device.fd(), VIDIOC_QUERYBUF, &bufferinfo) < 0)
+    //driver can adjust number of buffers
+    if (bufrequest.count < 1)
     {
-        throw std::runtime_error("Unable request size of memory buffers for device : " + device.fileName());
+        throw std::runtime_error("Insufficient buffer memory on device : " + device.fileName());
     }
 
-    //map memory
-    char* buffer_start = static_cast<char*>(mmap(
-        NULL,
-        bufferinfo.length,
-        PROT_READ | PROT_WRITE,
-        MAP_SHARED,
-        device.fd(),
-        bufferinfo.m.offset
-    ));
+    //map memory, each buffer is wrapped to RAII
+    buffers.reserve(bufrequest.count);
+    for (unsigned i = 0; i < bufrequest.count; ++i)
+    {
+        buffers.emplace_back(new ScopedMMapBuffer(device.fd(), i, device.fileName()));
+    }
+}
 
-    if(buffer_start == MAP_FAILED)
+V4LCamera::~V4LCamera()
+{
+    try
     {
-        throw std::runtime_error("Unable map memory buffers for device : " + device.fileName());
+        stopCapture();
     }
-    else
+    catch(std::exception& err)
     {
-        //wrap to RAII
-        buffer.init(buffer_start, bufferinfo.length);
+        std::cerr << err.what() << std::endl;
     }
-
-    //clear emory
-    memset(buffer_start, 0, bufferinfo.length);
 }
 
-V4LCamera::~V4LCamera()
+void V4LCamera::queueBuffer(unsigned index)
 {
-    stopCapture();
+    struct v4l2_buffer bufferinfo;
+    memset(&bufferinfo, 0, sizeof(bufferinfo));
+
+    bufferinfo.type = vide_type;
+    bufferinfo.memory = V4L2_MEMORY_MMAP;
+    bufferinfo.index = index;
+
+    // Put the buffer in the incoming queue.
+    if(ioctl(device.fd(), VIDIOC_QBUF, &bufferinfo) < 0)
+    {
+       throw std::runtime_error("Unable to put buffer in device queue : " + device.fileName());
+    }
 }
 
 void V4LCamera::startCapture()
 {
+    //all buffers are given to the driver, so it can fill them while we decode previous frames
+    for (unsigned i = 0; i < buffers.size(); ++i)
+    {
+        queueBuffer(i);
+    }
+
     auto type = vide_type;
     if(ioctl(device.fd(), VIDIOC_STREAMON, &type) < 0)
     {
         throw std::runtime_error("Unable to strat streaming device : " + device.fileName());
     }
 
+    hasSequence = false;
+    droppedFrames = 0;
     capturing = true;
 }
 
@@ -127,6 +167,7 @@ void V4LCamera::stopCapture()
 {
     if (capturing)
     {
+        //stream off also removes all buffers from driver queues
         auto type = vide_type;
         if(ioctl(device.fd(), VIDIOC_STREAMOFF, &type) < 0)
         {
@@ -136,20 +177,113 @@ void V4LCamera::stopCapture()
     }
 }
 
-void V4LCamera::getFrame(std::vector<char> &buffer)
+V4LCamera::FrameLease::FrameLease()
+    : owner(nullptr)
+    , index(0)
+    , frameData(nullptr)
+    , frameSize(0)
+    , frameTimestamp(0)
+    , frameSequence(0)
+{
+
+}
+
+V4LCamera::FrameLease::FrameLease(V4LCamera* owner, unsigned index, const char* data, size_t size,
+                                  unsigned long long timestamp, unsigned sequence)
+    : owner(owner)
+    , index(index)
+    , frameData(data)
+    , frameSize(size)
+    , frameTimestamp(timestamp)
+    , frameSequence(sequence)
+{
+
+}
+
+V4LCamera::FrameLease::FrameLease(FrameLease&& lease)
+    : FrameLease()
+{
+    *this = std::move(lease);
+}
+
+V4LCamera::FrameLease& V4LCamera::FrameLease::operator=(FrameLease&& lease)
+{
+    if (this != &lease)
+    {
+        release();
+        owner = lease.owner;
+        index = lease.index;
+        frameData = lease.frameData;
+        frameSize = lease.frameSize;
+        frameTimestamp = lease.frameTimestamp;
+        frameSequence = lease.frameSequence;
+        lease.owner = nullptr;
+        lease.frameData = nullptr;
+        lease.frameSize = 0;
+    }
+    return *this;
+}
+
+V4LCamera::FrameLease::~FrameLease()
+{
+    try
+    {
+        release();
+    }
+    catch(std::exception& err)
+    {
+        std::cerr << err.what() << std::endl;
+    }
+}
+
+void V4LCamera::FrameLease::release()
+{
+    if (owner != nullptr)
+    {
+        V4LCamera* camera = owner;
+        owner = nullptr;
+        frameData = nullptr;
+        frameSize = 0;
+        //buffers are dequeued from driver by stream off, so do not put them back
+        if (camera->capturing)
+        {
+            camera->queueBuffer(index);
+        }
+    }
+}
+
+bool V4LCamera::FrameLease::empty() const
+{
+    return frameData == nullptr;
+}
+
+const char* V4LCamera::FrameLease::data() const
+{
+    return frameData;
+}
+
+size_t V4LCamera::FrameLease::size() const
+{
+    return frameSize;
+}
+
+unsigned long long V4LCamera::FrameLease::timestamp() const
+{
+    return frameTimestamp;
+}
+
+unsigned V4LCamera::FrameLease::sequence() const
+{
+    return frameSequence;
+}
+
+V4LCamera::FrameLease V4LCamera::acquireFrame()
 {
     struct v4l2_buffer bufferinfo;
     memset(&bufferinfo, 0, sizeof(bufferinfo));
 
     bufferinfo.type = vide_type;
     bufferinfo.memory = V4L2_MEMORY_MMAP;
-    bufferinfo.index = 0;    
-
-    // Put the buffer in the incoming queue.
-    if(ioctl(device.fd(), VIDIOC_QBUF, &bufferinfo) < 0)
-    {
-       throw std::runtime_error("Unable to put buffer in device queue : " + device.fileName());
-    }
 
     // The buffer's waiting in the outgoing queue.
     if(ioctl(device.fd(), VIDIOC_DQBUF, &bufferinfo) < 0)
@@ -157,10 +291,45 @@ void V4LCamera::getFrame(std::vector<char> &buffer)
         throw std::runtime_error("Unable to query buffer from device : " + device.fileName());
     }
 
-    buffer.resize(this->buffer.length);
-    memcpy(buffer.data(), this->buffer.buffer, this->buffer.length);    
+    if (bufferinfo.index >= buffers.size())
+    {
+        throw std::runtime_error("Invalid buffer index from device : " + device.fileName());
+    }
+
+    if (hasSequence && bufferinfo.sequence > lastSequence + 1)
+    {
+        droppedFrames += bufferinfo.sequence - lastSequence - 1;
+    }
+    lastSequence = bufferinfo.sequence;
+    hasSequence = true;
+
+    const ScopedMMapBuffer& mmapBuffer = *buffers[bufferinfo.index];
+    //compressed formats occupy only part of the buffer
+    size_t size = bufferinfo.bytesused != 0 ? bufferinfo.bytesused : mmapBuffer.length;
+    size = std::min(size, mmapBuffer.length);
+
+    unsigned long long timestamp = static_cast<unsigned long long>(bufferinfo.timestamp.tv_sec) * 1000000ULL +
+                                   static_cast<unsigned long long>(bufferinfo.timestamp.tv_usec);
+
+    return FrameLease(this, bufferinfo.index, static_cast<const char*>(mmapBuffer.buffer), size,
+                      timestamp, bufferinfo.sequence);
+}
+
+void V4LCamera::getFrame(std::vector<char> &buffer)
+{
+    FrameLease lease = acquireFrame();
+    buffer.assign(lease.data(), lease.data() + lease.size());
+}
+
+unsigned V4LCamera::getBuffersCount() const
+{
+    return static_cast<unsigned>(buffers.size());
 }
 
+unsigned long long V4LCamera::getDroppedFrames() const
+{
+    return droppedFrames;
+}
 
 
 }}
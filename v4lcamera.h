@@ -13,7 +13,9 @@ namespace utils {
 class V4LCamera
 {
 public:
-    V4LCamera(int devId, const VideoDevFormat& format);
+    static const unsigned defaultBuffersCount = 4;
+
+    V4LCamera(int devId, const VideoDevFormat& format, unsigned buffersCount = defaultBuffersCount);
     V4LCamera(const V4LCamera&) = delete;
     V4LCamera& operator=(const V4LCamera&) = delete;
     ~V4LCamera();
@@ -21,24 +23,71 @@ public:
     void startCapture();
     void stopCapture();
 
+    //borrowed view of a filled driver buffer, buffer is returned to the driver queue on release
+    class FrameLease
+    {
+    public:
+        FrameLease();
+        FrameLease(FrameLease&& lease);
+        FrameLease& operator=(FrameLease&& lease);
+        FrameLease(const FrameLease&) = delete;
+        FrameLease& operator=(const FrameLease&) = delete;
+        ~FrameLease();
+
+        void release();
+
+        bool empty() const;
+        const char* data() const;
+        size_t size() const;
+        //microseconds, driver clock (usually CLOCK_MONOTONIC)
+        unsigned long long timestamp() const;
+        unsigned sequence() const;
+
+    private:
+        friend class V4LCamera;
+        FrameLease(V4LCamera* owner, unsigned index, const char* data, size_t size,
+                   unsigned long long timestamp, unsigned sequence);
+
+        V4LCamera* owner;
+        unsigned index;
+        const char* frameData;
+        size_t frameSize;
+        unsigned long long frameTimestamp;
+        unsigned frameSequence;
+    };
+
+    FrameLease acquireFrame();
+
     void getFrame(std::vector<char>& buffer);
 
+    unsigned getBuffersCount() const;
+
+    //number of frames dropped by the driver, detected by gaps in buffer sequence numbers
+    unsigned long long getDroppedFrames() const;
+
+private:
+    void queueBuffer(unsigned index);
+
 private:
     ScopedVideoDevice device;
 
     class ScopedMMapBuffer
     {
     public:
-        ScopedMMapBuffer();
+        ScopedMMapBuffer(int fd, unsigned index, const std::string& devName);
         ~ScopedMMapBuffer();
-        void init(void* buf, size_t length);
+        ScopedMMapBuffer(const ScopedMMapBuffer&) = delete;
+        ScopedMMapBuffer& operator=(const ScopedMMapBuffer&) = delete;
 
         void* buffer;
         size_t length;
     };
 
-    ScopedMMapBuffer buffer;
+    std::vector<std::unique_ptr<ScopedMMapBuffer>> buffers;
     bool capturing;
+    bool hasSequence;
+    unsigned lastSequence;
+    unsigned long long droppedFrames;
 };
 
 }}